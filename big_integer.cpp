@@ -1,27 +1,822 @@
 #include "big_integer.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <istream>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <ostream>
 #include <stdexcept>
+#include <thread>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 const big_integer big_integer::ZERO = 0;
-const std::vector<uint32_t> big_integer::TEN_POWERS = {10,      100,      1000,      10000,     100000,
-                                                       1000000, 10000000, 100000000, 1000000000};
 
-bool big_integer::is_correct_digit(char ch) noexcept {
-  return std::isdigit(static_cast<unsigned int>(ch));
+namespace {
+// Kernels below work on raw little-endian limb arrays, so that division and shifts can run on
+// caller-provided buffers without intermediate big_integer objects.
+using limb = big_integer::limb;
+using double_limb = big_integer::double_limb;
+constexpr int LIMB_BITS = std::numeric_limits<limb>::digits;
+constexpr limb LIMB_MAX = std::numeric_limits<limb>::max();
+
+// dst[0..n) = src[0..n) << shift, 0 <= shift < LIMB_BITS, returns the bits shifted out.
+// dst may overlap src as long as dst >= src.
+limb shift_left_limbs(limb* dst, const limb* src, size_t n, int shift) noexcept {
+  if (shift == 0) {
+    std::copy_backward(src, src + n, dst + n);
+    return 0;
+  }
+  limb out = 0;
+  for (size_t i = n; i > 0; --i) {
+    limb cur = src[i - 1];
+    if (i == n) {
+      out = cur >> (LIMB_BITS - shift);
+    } else {
+      dst[i] |= cur >> (LIMB_BITS - shift);
+    }
+    dst[i - 1] = cur << shift;
+  }
+  return out;
+}
+
+// dst[0..n) = src[0..n) >> shift, 0 <= shift < LIMB_BITS. dst may overlap src as long as dst <= src.
+void shift_right_limbs(limb* dst, const limb* src, size_t n, int shift) noexcept {
+  if (shift == 0) {
+    if (dst != src) {
+      std::copy(src, src + n, dst);
+    }
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    limb high = (i + 1 < n ? src[i + 1] << (LIMB_BITS - shift) : 0);
+    dst[i] = (src[i] >> shift) | high;
+  }
+}
+
+// Below thresholds (in limbs) the quadratic algorithms are faster than the recursive ones.
+constexpr size_t KARATSUBA_THRESHOLD = 32;
+constexpr size_t DC_DIV_THRESHOLD = 48;
+constexpr size_t TO_STRING_THRESHOLD = 40;
+constexpr size_t FROM_STRING_THRESHOLD = 40; // in chunks of digits
+constexpr size_t PARALLEL_THRESHOLD = 4096; // in limbs (chunks of digits when parsing), smaller is not worth a thread
+constexpr int STREAM_BLOCK_LEVEL = 9;         // streams move d * 2^9 digits at a time, d = chunk_digits <= 31
+
+// Decimal conversion works with chunks of 9 digits, the largest power of ten that fits in 32 bits.
+constexpr uint32_t DECIMAL_CHUNK = 1000000000;
+constexpr size_t DECIMAL_CHUNK_DIGITS = 9;
+constexpr uint32_t TEN_POWERS[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+// r[0..n) = a[0..n) + b[0..n), returns the carry. r may alias a or b.
+limb add_n(limb* r, const limb* a, const limb* b, size_t n) noexcept {
+  double_limb carry = 0;
+  for (size_t i = 0; i < n; ++i) {
+    carry += static_cast<double_limb>(a[i]) + b[i];
+    r[i] = static_cast<limb>(carry);
+    carry >>= LIMB_BITS;
+  }
+  return static_cast<limb>(carry);
+}
+
+// r[0..n) = a[0..n) - b[0..n), returns the borrow. r may alias a or b.
+limb sub_n(limb* r, const limb* a, const limb* b, size_t n) noexcept {
+  double_limb borrow = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double_limb cur = static_cast<double_limb>(a[i]) - b[i] - borrow;
+    r[i] = static_cast<limb>(cur);
+    borrow = cur >> (2 * LIMB_BITS - 1);
+  }
+  return static_cast<limb>(borrow);
+}
+
+// r[0..n) = a[0..n) + x, returns the carry. r may alias a.
+limb add_1(limb* r, const limb* a, size_t n, limb x) noexcept {
+  double_limb carry = x;
+  for (size_t i = 0; i < n; ++i) {
+    carry += a[i];
+    r[i] = static_cast<limb>(carry);
+    carry >>= LIMB_BITS;
+  }
+  return static_cast<limb>(carry);
+}
+
+// r[0..n) = a[0..n) - x, returns the borrow. r may alias a.
+limb sub_1(limb* r, const limb* a, size_t n, limb x) noexcept {
+  double_limb borrow = x;
+  for (size_t i = 0; i < n; ++i) {
+    double_limb cur = static_cast<double_limb>(a[i]) - borrow;
+    r[i] = static_cast<limb>(cur);
+    borrow = cur >> (2 * LIMB_BITS - 1);
+  }
+  return static_cast<limb>(borrow);
+}
+
+// r[0..na) = a[0..na) + b[0..nb), na >= nb, returns the carry. r may alias a or b.
+limb add_limbs(limb* r, const limb* a, size_t na, const limb* b, size_t nb) noexcept {
+  limb carry = add_n(r, a, b, nb);
+  return add_1(r + nb, a + nb, na - nb, carry);
+}
+
+// r[0..na) = a[0..na) - b[0..nb), na >= nb, returns the borrow. r may alias a or b.
+limb sub_limbs(limb* r, const limb* a, size_t na, const limb* b, size_t nb) noexcept {
+  limb borrow = sub_n(r, a, b, nb);
+  return sub_1(r + nb, a + nb, na - nb, borrow);
+}
+
+int cmp_n(const limb* a, const limb* b, size_t n) noexcept {
+  for (size_t i = n; i > 0; --i) {
+    if (a[i - 1] != b[i - 1]) {
+      return a[i - 1] < b[i - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// r[0..n) += a[0..n) * x, returns the carry limb.
+limb addmul_1(limb* r, const limb* a, size_t n, limb x) noexcept {
+  double_limb carry = 0;
+  for (size_t i = 0; i < n; ++i) {
+    carry += static_cast<double_limb>(a[i]) * x + r[i];
+    r[i] = static_cast<limb>(carry);
+    carry >>= LIMB_BITS;
+  }
+  return static_cast<limb>(carry);
 }
 
-void big_integer::remove_leading_zeros(std::vector<uint32_t>& v) noexcept {
-  while (!v.empty() && v.back() == 0) {
+// r[0..n) -= a[0..n) * x, returns the borrow limb.
+limb submul_1(limb* r, const limb* a, size_t n, limb x) noexcept {
+  limb borrow = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double_limb product = static_cast<double_limb>(a[i]) * x + borrow;
+    limb low = static_cast<limb>(product);
+    borrow = static_cast<limb>(product >> LIMB_BITS) + (r[i] < low);
+    r[i] -= low;
+  }
+  return borrow;
+}
+
+// r[0..n) = a[0..n) * x + carry, returns the carry limb. r may alias a.
+limb mul_1(limb* r, const limb* a, size_t n, limb x, limb carry = 0) noexcept {
+  double_limb acc = carry;
+  for (size_t i = 0; i < n; ++i) {
+    acc += static_cast<double_limb>(a[i]) * x;
+    r[i] = static_cast<limb>(acc);
+    acc >>= LIMB_BITS;
+  }
+  return static_cast<limb>(acc);
+}
+
+// Index of the first character in [first, first + length) that is not a decimal digit, or length.
+// Checks 32 (AVX2) or 16 (SSE2) characters per step: c is a digit iff max(c - '0', 9) == 9 as unsigned bytes.
+size_t find_non_digit(const char* first, size_t length) noexcept {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i zero_256 = _mm256_set1_epi8('0');
+  const __m256i nine_256 = _mm256_set1_epi8(9);
+  for (; i + 32 <= length; i += 32) {
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i));
+    __m256i values = _mm256_sub_epi8(chars, zero_256);
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_max_epu8(values, nine_256), nine_256);
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(is_digit));
+    if (mask != 0xFFFFFFFFu) {
+      return i + std::countr_one(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i zero_128 = _mm_set1_epi8('0');
+  const __m128i nine_128 = _mm_set1_epi8(9);
+  for (; i + 16 <= length; i += 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+    __m128i values = _mm_sub_epi8(chars, zero_128);
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_max_epu8(values, nine_128), nine_128);
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(is_digit));
+    if (mask != 0xFFFFu) {
+      return i + std::countr_one(mask);
+    }
+  }
+#endif
+  for (; i < length; ++i) {
+    if (static_cast<unsigned char>(first[i] - '0') > 9) {
+      return i;
+    }
+  }
+  return length;
+}
+
+// Value of 8 decimal digits. SWAR: digit pairs, then quads, then both halves are combined in one register.
+uint32_t read_8_digits(const char* first) noexcept {
+  if constexpr (std::endian::native == std::endian::little) {
+    uint64_t chunk;
+    std::memcpy(&chunk, first, sizeof(chunk));
+    chunk -= 0x3030303030303030;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FF;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFF;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0xFFFFFFFF;
+    return static_cast<uint32_t>(chunk);
+  } else {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      value = value * 10 + static_cast<uint32_t>(first[i] - '0');
+    }
+    return value;
+  }
+}
+
+// Value of 16 decimal digits: the SSE4.1 version multiplies and adds neighbouring lanes with weights 10, 100
+// and 10000, producing the two 8-digit halves.
+uint64_t read_16_digits(const char* first) noexcept {
+#if defined(__SSE4_1__)
+  __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+  __m128i values = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  __m128i pairs = _mm_maddubs_epi16(values, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  __m128i packed = _mm_packus_epi32(quads, quads);
+  __m128i halves = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+  uint64_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(halves));
+  uint64_t low = static_cast<uint32_t>(_mm_extract_epi32(halves, 1));
+  return high * 100000000 + low;
+#else
+  return static_cast<uint64_t>(read_8_digits(first)) * 100000000 + read_8_digits(first + 8);
+#endif
+}
+
+// Value of the decimal digits [first, first + length), length <= 19.
+uint64_t read_decimal_group(const char* first, size_t length) noexcept {
+  uint64_t value = 0;
+  size_t i = 0;
+  if (length >= 16) {
+    value = read_16_digits(first);
+    i = 16;
+  } else if (length >= 8) {
+    value = read_8_digits(first);
+    i = 8;
+  }
+  for (; i < length; ++i) {
+    value = value * 10 + static_cast<uint64_t>(first[i] - '0');
+  }
+  return value;
+}
+
+// "00", "01", ..., "99": output is emitted two digits per table lookup.
+constexpr char DIGIT_PAIRS[] = "0001020304050607080910111213141516171819"
+                               "2021222324252627282930313233343536373839"
+                               "4041424344454647484950515253545556575859"
+                               "6061626364656667686970717273747576777879"
+                               "8081828384858687888990919293949596979899";
+
+// Writes value < 10^9 as exactly 9 digits. jeaiii-style: value / 10^8 is kept as a fixed-point number with a
+// 57-bit fraction, each multiplication by 100 then moves the next two digits into the integer part.
+void write_9_digits(char* out, uint32_t value) noexcept {
+  constexpr uint64_t fraction_mask = (uint64_t(1) << 57) - 1;
+  uint64_t y = value * uint64_t(1441151881); // ceil(2^57 / 10^8)
+  out[0] = static_cast<char>('0' + (y >> 57));
+  for (size_t i = 1; i < 9; i += 2) {
+    y = (y & fraction_mask) * 100;
+    std::memcpy(out + i, DIGIT_PAIRS + 2 * (y >> 57), 2);
+  }
+}
+
+// Number of digits of 0 < value < 10^9.
+size_t short_decimal_length(uint32_t value) noexcept {
+  size_t length = (std::bit_width(value) * 1233) >> 12; // floor(log10(2^bit_width))
+  return length + (value >= TEN_POWERS[length]);
+}
+
+// Writes 0 < value < 10^9 without leading zeros, returns the end of the written digits.
+char* write_short_decimal(char* out, uint32_t value) noexcept {
+  size_t length = short_decimal_length(value);
+  char* end = out + length;
+  for (; value >= 100; value /= 100) {
+    end -= 2;
+    std::memcpy(end, DIGIT_PAIRS + 2 * (value % 100), 2);
+  }
+  if (value >= 10) {
+    std::memcpy(out, DIGIT_PAIRS + 2 * value, 2);
+  } else {
+    out[0] = static_cast<char>('0' + value);
+  }
+  return out + length;
+}
+
+// Parameters of a base 2..36. Digits are converted in chunks of chunk = base^chunk_digits, the largest power
+// of the base that fits in 32 bits (so in a limb of either width); power-of-two bases are instead sliced log2 bits
+// at a time.
+struct radix_info {
+  uint32_t base;
+  uint32_t chunk;
+  size_t chunk_digits;
+  int log2; // 0 unless base is a power of two
+};
+
+constexpr std::array<radix_info, 37> RADIXES = [] {
+  std::array<radix_info, 37> radixes{};
+  for (uint32_t base = 2; base <= 36; ++base) {
+    radix_info& radix = radixes[base];
+    radix.base = base;
+    radix.chunk = 1;
+    while (radix.chunk <= UINT32_MAX / base) {
+      radix.chunk *= base;
+      ++radix.chunk_digits;
+    }
+    radix.log2 = std::has_single_bit(base) ? std::countr_zero(base) : 0;
+  }
+  return radixes;
+}();
+
+// Process-wide tables of chunk^(2^k) for every base, grown on demand. Levels are immutable once published,
+// so readers only need an acquire load; growth is serialized per base.
+constexpr size_t MAX_POWER_LEVELS = 64;
+
+struct cached_powers {
+  std::mutex growth;
+  std::atomic<const big_integer*> levels[MAX_POWER_LEVELS] = {};
+};
+
+cached_powers POWER_CACHE[37];
+
+// The cache outlives any memory resource a caller might install, so its levels never take storage from one.
+big_integer::allocator_type power_cache_allocator() noexcept {
+#if BIG_INTEGER_PMR
+  return std::pmr::new_delete_resource();
+#else
+  return {};
+#endif
+}
+
+// ceil(2^32 / log2(base)): digits of the base per 2^32 bits, rounded up.
+constexpr uint64_t DIGITS_PER_2_32_BITS[] = {
+    0,          0,          4294967296, 2709822658, 2147483648, 1849741733, 1661520156, 1529898220,
+    1431655766, 1354911329, 1292913987, 1241523976, 1198050830, 1160664036, 1128071164, 1099331346,
+    1073741824, 1050766078, 1029986702, 1011073585, 993761859,  977836273,  963119892,  949465784,
+    936750802,  924870867,  913737343,  903274220,  893415895,  884105414,  875293063,  866935226,
+    858993460,  851433730,  844225783,  837342624,  830760078};
+
+constexpr char DIGIT_CHARS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+// Value of every character as a digit, 0xFF for non-digits. Letters of both cases stand for 10..35.
+constexpr std::array<uint8_t, 256> DIGIT_VALUES = [] {
+  std::array<uint8_t, 256> values{};
+  values.fill(0xFF);
+  for (uint8_t i = 0; i < 36; ++i) {
+    values[static_cast<unsigned char>(DIGIT_CHARS[i])] = i;
+    if (i >= 10) {
+      values[static_cast<unsigned char>(DIGIT_CHARS[i] - 'a' + 'A')] = i;
+    }
+  }
+  return values;
+}();
+
+// Index of the first character in [first, first + length) that is not a digit in `base`, or length.
+size_t find_non_digit(const char* first, size_t length, uint32_t base) noexcept {
+  if (base == 10) {
+    return find_non_digit(first, length);
+  }
+  for (size_t i = 0; i < length; ++i) {
+    if (DIGIT_VALUES[static_cast<unsigned char>(first[i])] >= base) {
+      return i;
+    }
+  }
+  return length;
+}
+
+// Value of the digits [first, first + length), base^length must fit in 32 bits.
+uint32_t read_chunk(const char* first, size_t length, uint32_t base) noexcept {
+  uint32_t value = 0;
+  for (size_t i = 0; i < length; ++i) {
+    value = value * base + DIGIT_VALUES[static_cast<unsigned char>(first[i])];
+  }
+  return value;
+}
+
+// Writes value < radix.chunk as exactly chunk_digits digits.
+void write_chunk(char* out, uint32_t value, const radix_info& radix) noexcept {
+  if (radix.base == 10) {
+    write_9_digits(out, value);
+    return;
+  }
+  for (size_t i = radix.chunk_digits; i > 0; --i) {
+    out[i - 1] = DIGIT_CHARS[value % radix.base];
+    value /= radix.base;
+  }
+}
+
+// Number of digits of value > 0.
+size_t short_length(uint32_t value, uint32_t base) noexcept {
+  if (base == 10) {
+    return short_decimal_length(value);
+  }
+  size_t length = 0;
+  for (; value > 0; value /= base) {
+    ++length;
+  }
+  return length;
+}
+
+// Writes value > 0 without leading zeros, returns the end of the written digits.
+char* write_short(char* out, uint32_t value, uint32_t base) noexcept {
+  if (base == 10) {
+    return write_short_decimal(out, value);
+  }
+  char* end = out + short_length(value, base);
+  for (char* p = end; value > 0; value /= base) {
+    *--p = DIGIT_CHARS[value % base];
+  }
+  return end;
+}
+
+// Writes `length` base 2^bits digits of x[0..n), the lowest of them starting at bit `offset`, most significant
+// first. O(length): the digits are sliced off a double-limb window that is refilled one limb at a time.
+void write_pow2_digits(char* out, size_t length, const limb* x, size_t n, int bits, uint64_t offset = 0) noexcept {
+  const limb mask = (limb(1) << bits) - 1;
+  size_t i = offset / LIMB_BITS;
+  double_limb window = (i < n ? x[i++] : 0) >> (offset % LIMB_BITS);
+  int window_bits = LIMB_BITS - static_cast<int>(offset % LIMB_BITS);
+  for (char* p = out + length; p != out;) {
+    if (window_bits < bits) {
+      window |= static_cast<double_limb>(i < n ? x[i++] : 0) << window_bits;
+      window_bits += LIMB_BITS;
+    }
+    *--p = DIGIT_CHARS[window & mask];
+    window >>= bits;
+    window_bits -= bits;
+  }
+}
+
+// Reads the base 2^bits digits [first, first + length) into r, which must hold ceil(length * bits / LIMB_BITS)
+// limbs.
+void read_pow2_digits(limb* r, const char* first, size_t length, int bits) noexcept {
+  double_limb window = 0;
+  int window_bits = 0;
+  for (const char* p = first + length; p != first;) {
+    window |= static_cast<double_limb>(DIGIT_VALUES[static_cast<unsigned char>(*--p)]) << window_bits;
+    window_bits += bits;
+    if (window_bits >= LIMB_BITS) {
+      *r++ = static_cast<limb>(window);
+      window >>= LIMB_BITS;
+      window_bits -= LIMB_BITS;
+    }
+  }
+  if (window_bits > 0) {
+    *r = static_cast<limb>(window);
+  }
+}
+
+// Thread-local stack of limbs for the temporaries of multiplication and division. Blocks are handed out and
+// given back in LIFO order through scratch_frame, and the memory is kept for the next operation: every new block
+// is at least as large as all the previous ones together, so an operation of any size grows the arena by a few
+// allocations at most. An operation that leaves more than MAX_RETAINED limbs in the arena frees them all when it
+// ends, so only threads working on small and medium numbers stop allocating altogether.
+class scratch_arena {
+public:
+  struct mark {
+    size_t block;
+    size_t used;
+  };
+
+  static scratch_arena& local() {
+    thread_local scratch_arena arena;
+    return arena;
+  }
+
+  // Starts a frame: everything allocated after it is given back by the matching close().
+  mark open() noexcept {
+    ++depth;
+    return {current, used};
+  }
+
+  void close(mark m) noexcept {
+    current = m.block;
+    used = m.used;
+    if (--depth == 0 && total > MAX_RETAINED) {
+      // Done with an operation on huge numbers: keep no more than a moderate amount for the next ones.
+      blocks.clear();
+      total = 0;
+      current = 0;
+      used = 0;
+    }
+  }
+
+  // n limbs, uninitialized.
+  limb* allocate(size_t n) {
+    for (; current < blocks.size(); ++current, used = 0) {
+      if (blocks[current].size - used >= n) {
+        limb* result = blocks[current].limbs.get() + used;
+        used += n;
+        return result;
+      }
+    }
+    add_block(n);
+    used = n;
+    return blocks.back().limbs.get();
+  }
+
+  // Makes room for allocations of n limbs in total, so that they need no more than this one new block.
+  void reserve(size_t n) {
+    for (size_t i = current; i < blocks.size(); ++i) {
+      if (blocks[i].size - (i == current ? used : 0) >= n) {
+        return;
+      }
+    }
+    add_block(n);
+  }
+
+private:
+  static constexpr size_t MIN_BLOCK = 1024;
+  static constexpr size_t MAX_RETAINED = 1 << 16;
+
+  struct block {
+    std::unique_ptr<limb[]> limbs;
+    size_t size;
+  };
+
+  void add_block(size_t n) {
+    size_t size = std::max({n, total, MIN_BLOCK});
+    blocks.push_back({std::make_unique_for_overwrite<limb[]>(size), size});
+    total += size;
+  }
+
+  std::vector<block> blocks;
+  size_t total = 0;
+  size_t current = 0;
+  size_t used = 0;
+  size_t depth = 0;
+};
+
+// Scratch limbs that are given back to the arena when the frame goes out of scope.
+class scratch_frame {
+public:
+  scratch_frame() : arena(scratch_arena::local()), saved(arena.open()) {}
+
+  scratch_frame(const scratch_frame&) = delete;
+  scratch_frame& operator=(const scratch_frame&) = delete;
+
+  ~scratch_frame() {
+    arena.close(saved);
+  }
+
+  limb* allocate(size_t n) {
+    return arena.allocate(n);
+  }
+
+  void reserve(size_t n) {
+    arena.reserve(n);
+  }
+
+private:
+  scratch_arena& arena;
+  scratch_arena::mark saved;
+};
+
+// r[0..na + nb) = a * b in O(na * nb), r must not overlap a or b.
+void mul_basecase(limb* r, const limb* a, size_t na, const limb* b, size_t nb) noexcept {
+  std::fill_n(r, na, 0);
+  for (size_t j = 0; j < nb; ++j) {
+    r[na + j] = addmul_1(r + j, a, na, b[j]);
+  }
+}
+
+// r[0..na + nb) = a * b, Karatsuba above KARATSUBA_THRESHOLD. r must not overlap a or b.
+void mul_limbs(limb* r, const limb* a, size_t na, const limb* b, size_t nb) {
+  if (na < nb) {
+    std::swap(a, b);
+    std::swap(na, nb);
+  }
+  if (nb < KARATSUBA_THRESHOLD) {
+    mul_basecase(r, a, na, b, nb);
+    return;
+  }
+  size_t h = (na + 1) / 2;
+  scratch_frame scratch;
+  // Enough for the whole recursion: about 2 * na limbs at this level and as much again below it.
+  scratch.reserve(4 * na + 16 * std::bit_width(na));
+  if (nb <= h) {
+    // Unbalanced: multiply b by nb-limb slices of a and accumulate.
+    limb* tmp = scratch.allocate(2 * nb);
+    mul_limbs(r, a, nb, b, nb);
+    for (size_t i = nb; i < na; i += nb) {
+      size_t len = std::min(nb, na - i);
+      mul_limbs(tmp, a + i, len, b, nb);
+      limb carry = add_n(r + i, r + i, tmp, nb);
+      add_1(r + i + nb, tmp + nb, len, carry);
+    }
+    return;
+  }
+
+  // a = a1 * B^h + a0, b = b1 * B^h + b0,
+  // a * b = z2 * B^2h + ((a0 + a1)(b0 + b1) - z0 - z2) * B^h + z0.
+  size_t na1 = na - h;
+  size_t nb1 = nb - h;
+  mul_limbs(r, a, h, b, h);
+  mul_limbs(r + 2 * h, a + h, na1, b + h, nb1);
+
+  limb* sa = scratch.allocate(h + 1);
+  limb* sb = scratch.allocate(h + 1);
+  limb* z1 = scratch.allocate(2 * h + 2);
+  sa[h] = add_limbs(sa, a, h, a + h, na1);
+  sb[h] = add_limbs(sb, b, h, b + h, nb1);
+  mul_limbs(z1, sa, h + 1, sb, h + 1);
+  sub_limbs(z1, z1, 2 * h + 2, r, 2 * h);
+  sub_limbs(z1, z1, 2 * h + 2, r + 2 * h, na1 + nb1);
+
+  size_t nz = 2 * h + 2;
+  while (nz > 0 && z1[nz - 1] == 0) {
+    --nz;
+  }
+  add_limbs(r + h, r + h, na + nb - h, z1, nz);
+}
+
+// Divides (rem:u[0..n)) by d, rem < d. Quotient goes to q (if not null), remainder is returned.
+limb divmod_limb(limb* q, const limb* u, size_t n, limb rem, limb d) noexcept {
+  if constexpr (LIMB_BITS == 64) {
+    if (d <= UINT32_MAX) {
+      // Divisors of radix conversions: two 64 by 32-bit steps per limb are much cheaper than a 128-bit division.
+      uint64_t acc = rem;
+      for (size_t i = n; i > 0; --i) {
+        uint64_t high = (acc << 32) | (static_cast<uint64_t>(u[i - 1]) >> 32);
+        uint64_t low = ((high % d) << 32) | static_cast<uint32_t>(u[i - 1]);
+        if (q != nullptr) {
+          q[i - 1] = static_cast<limb>((static_cast<double_limb>(high / d) << 32) | (low / d));
+        }
+        acc = low % d;
+      }
+      return static_cast<limb>(acc);
+    }
+  }
+  double_limb acc = rem;
+  for (size_t i = n; i > 0; --i) {
+    acc = (acc << LIMB_BITS) | u[i - 1];
+    if (q != nullptr) {
+      q[i - 1] = static_cast<limb>(acc / d);
+    }
+    acc %= d;
+  }
+  return static_cast<limb>(acc);
+}
+
+// Knuth's algorithm D. u has m + n + 1 limbs, v has n >= 2 limbs with the top bit of v[n - 1] set.
+// Quotient (m + 1 limbs) goes to q if it is not null, remainder replaces u[0..n).
+void divmod_knuth(limb* q, limb* u, size_t m, const limb* v, size_t n) noexcept {
+  const double_limb v_top = v[n - 1];
+  const double_limb v_next = v[n - 2];
+  for (size_t j = m + 1; j > 0; --j) {
+    limb* uj = u + (j - 1);
+    double_limb num = (static_cast<double_limb>(uj[n]) << LIMB_BITS) | uj[n - 1];
+    double_limb qhat = num / v_top;
+    double_limb rhat = num % v_top;
+    while (qhat > LIMB_MAX || qhat * v_next > ((rhat << LIMB_BITS) | uj[n - 2])) {
+      --qhat;
+      rhat += v_top;
+      if (rhat > LIMB_MAX) {
+        break;
+      }
+    }
+
+    limb borrow = submul_1(uj, v, n, static_cast<limb>(qhat));
+    limb top = uj[n];
+    uj[n] = top - borrow;
+    if (top < borrow) {
+      // qhat was one too large: add the divisor back.
+      --qhat;
+      uj[n] += add_n(uj, uj, v, n);
+    }
+    if (q != nullptr) {
+      q[j - 1] = static_cast<limb>(qhat);
+    }
+  }
+}
+
+// Divides {u, nu} by {v, n}, nu >= n >= 2, top bit of v[n - 1] set. Stores the low nu - n quotient limbs
+// to q (if it is not null) and returns the high quotient limb (0 or 1); remainder replaces u[0..n).
+limb div_schoolbook(limb* q, limb* u, size_t nu, const limb* v, size_t n) noexcept {
+  limb qh = (cmp_n(u + nu - n, v, n) >= 0);
+  if (qh) {
+    sub_n(u + nu - n, u + nu - n, v, n);
+  }
+  if (nu > n) {
+    divmod_knuth(q, u, nu - n - 1, v, n);
+  }
+  return qh;
+}
+
+// Recursive (Burnikel-Ziegler style) division of {u, 2n} by normalized {v, n}: the quotient halves are
+// estimated from the top halves of the divisor and then corrected by the low halves.
+// Quotient goes to q[0..n), its high limb is returned, remainder replaces u[0..n). tp is n limbs of scratch.
+limb div_dc_n(limb* q, limb* u, const limb* v, size_t n, limb* tp) {
+  if (n < DC_DIV_THRESHOLD) {
+    return div_schoolbook(q, u, 2 * n, v, n);
+  }
+  size_t lo = n / 2;
+  size_t hi = n - lo;
+
+  limb qh = div_dc_n(q + lo, u + 2 * lo, v + lo, hi, tp);
+  mul_limbs(tp, q + lo, hi, v, lo);
+  limb borrow = sub_n(u + lo, u + lo, tp, n);
+  if (qh) {
+    borrow += sub_n(u + n, u + n, v, lo);
+  }
+  while (borrow != 0) {
+    qh -= sub_1(q + lo, q + lo, hi, 1);
+    borrow -= add_n(u + lo, u + lo, v, n);
+  }
+
+  limb ql = div_dc_n(q, u + hi, v + hi, lo, tp);
+  mul_limbs(tp, v, hi, q, lo);
+  borrow = sub_n(u, u, tp, n);
+  if (ql) {
+    borrow += sub_n(u + lo, u + lo, v, hi);
+  }
+  while (borrow != 0) {
+    sub_1(q, q, lo, 1);
+    borrow -= add_n(u, u, v, n);
+  }
+  return qh;
+}
+
+// Divides {u, nu} by normalized {v, n}, nu >= n >= 2, same contract as div_schoolbook.
+// Large quotients are produced n limbs at a time from the top.
+limb div_limbs(limb* q, limb* u, size_t nu, const limb* v, size_t n) {
+  size_t qn = nu - n;
+  if (n < DC_DIV_THRESHOLD || qn < DC_DIV_THRESHOLD) {
+    return div_schoolbook(q, u, nu, v, n);
+  }
+  scratch_frame scratch;
+  // The quotient, tp and the products of up to n by n limbs that correct the estimates.
+  scratch.reserve(qn + 5 * n + 16 * std::bit_width(n));
+  // The recursive algorithm needs the quotient to correct its estimates even if the caller does not.
+  if (q == nullptr) {
+    q = scratch.allocate(qn);
+  }
+  limb* tp = scratch.allocate(n);
+  limb qh = (cmp_n(u + qn, v, n) >= 0);
+  if (qh) {
+    sub_n(u + qn, u + qn, v, n);
+  }
+  while (qn > 0) {
+    // Block {uc, n + c} has its top n limbs below v, so its quotient fits in c limbs.
+    size_t c = (qn % n == 0 ? n : qn % n);
+    qn -= c;
+    limb* uc = u + qn;
+    limb* qc = q + qn;
+    if (c == n) {
+      div_dc_n(qc, uc, v, n, tp);
+    } else if (c < DC_DIV_THRESHOLD) {
+      div_schoolbook(qc, uc, n + c, v, n);
+    } else {
+      limb ql = div_dc_n(qc, uc + n - c, v + n - c, c, tp);
+      mul_limbs(tp, qc, c, v, n - c);
+      limb borrow = sub_n(uc, uc, tp, n);
+      if (ql) {
+        borrow += sub_n(uc + c, uc + c, v, n - c);
+      }
+      while (borrow != 0) {
+        sub_1(qc, qc, c, 1);
+        borrow -= add_n(uc, uc, v, n);
+      }
+    }
+  }
+  return qh;
+}
+
+// Every chunk holds at least 27 bits (the smallest is 24^6), which bounds the chunks of a basecase number.
+constexpr size_t MAX_BASECASE_CHUNKS = TO_STRING_THRESHOLD * LIMB_BITS / 27 + 2;
+
+// Peels base `chunk` digits off x[0..n), n < TO_STRING_THRESHOLD, least significant first. Returns their number.
+size_t radix_chunks(uint32_t* chunks, const limb* x, size_t n, uint32_t chunk) noexcept {
+  limb buf[TO_STRING_THRESHOLD];
+  std::copy(x, x + n, buf);
+  size_t count = 0;
+  while (n > 0) {
+    chunks[count++] = static_cast<uint32_t>(divmod_limb(buf, buf, n, 0, chunk));
+    while (n > 0 && buf[n - 1] == 0) {
+      --n;
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+void big_integer::remove_leading_zeros(limbs& v) noexcept {
+  while (!v.empty() && std::as_const(v).back() == 0) {
     v.pop_back();
   }
 }
 
-bool big_integer::abs_greater(const big_integer& rhs) noexcept { // |this| > |rhs|
+bool big_integer::abs_greater(const big_integer& rhs) const noexcept { // |this| > |rhs|
   if (size() > rhs.size()) {
     return true;
   } else if (size() < rhs.size()) {
@@ -34,30 +829,20 @@ bool big_integer::abs_greater(const big_integer& rhs) noexcept { // |this| > |rh
 
 void big_integer::negate() noexcept {
   if (*this != 0) {
-    is_negative ^= 1;
+    set_negative(!negative());
   }
 }
 
-void big_integer::apply_additional_code() {
-  is_negative = false;
-  for (size_t i = 0; i < size(); i++) {
-    digits[i] = ~digits[i];
-  }
-  ++(*this);
-}
-
-void big_integer::add_to_ith(size_t pos, uint32_t x) {
-  for (size_t i = pos; i < size() && x > 0; ++i) {
-    uint64_t result = static_cast<uint64_t>(digits[i]) + x;
-    digits[i] = result & MASK;
-    x = result >> BASE_LOG2;
+void big_integer::add_to_ith(size_t pos, limb x) {
+  if (pos < size()) {
+    x = add_1(digits.data() + pos, digits.data() + pos, size() - pos, x);
   }
   if (x) {
     digits.emplace_back(x);
   }
 }
 
-uint32_t big_integer::first_digit() const noexcept {
+big_integer::limb big_integer::first_digit() const noexcept {
   if (*this == big_integer::ZERO) {
     return 0;
   } else {
@@ -65,67 +850,65 @@ uint32_t big_integer::first_digit() const noexcept {
   }
 }
 
-void big_integer::swap(big_integer& other) noexcept {
-  std::swap(is_negative, other.is_negative);
-  std::swap(digits, other.digits);
+void big_integer::swap(big_integer& other) noexcept(std::is_nothrow_swappable_v<limbs>) {
+  digits.swap(other.digits);
 }
 
 size_t big_integer::size() const noexcept {
   return digits.size();
 }
 
-big_integer::big_integer(std::vector<uint32_t>& digits, bool is_negative) : digits(digits), is_negative(is_negative) {}
+big_integer::big_integer(limbs digits, bool is_negative) : digits(std::move(digits)) {
+  set_negative(is_negative);
+}
 
-big_integer::big_integer() : digits(), is_negative(false) {}
+big_integer::big_integer() : digits() {}
 
-big_integer::big_integer(const std::string& str) : digits(), is_negative(false) {
-  bool negative = false;
+big_integer::big_integer(big_integer&& other) noexcept : digits(std::move(other.digits)) {}
+
+big_integer::big_integer(std::allocator_arg_t, const allocator_type& alloc) noexcept : digits(alloc) {}
+
+big_integer::big_integer(std::allocator_arg_t, const allocator_type& alloc, const big_integer& other)
+    : digits(other.digits, alloc) {}
+
+big_integer::big_integer(std::allocator_arg_t, const allocator_type& alloc, big_integer&& other)
+    : digits(std::move(other.digits), alloc) {}
+
+big_integer::allocator_type big_integer::get_allocator() const noexcept {
+  return digits.get_allocator();
+}
+
+big_integer::big_integer(std::string_view str, int base) : big_integer(str, base, 1) {}
+
+big_integer::big_integer(std::string_view str, int base, unsigned threads) : digits() {
+  if (base < 2 || base > 36) {
+    throw std::invalid_argument("Base must be in range [2, 36]");
+  }
   if (str.empty()) {
     throw std::invalid_argument("String initializer must not be empty");
   }
-  size_t offset = 0;
-  if (str[0] == '-') {
-    if (str.length() == 1) {
-      throw std::invalid_argument("Wrong string initializer: \"-\"");
-    }
-    offset++;
-    negative = true;
-  }
-  while (offset < str.size() && str[offset] == '0') {
-    offset++;
-  }
-  if (offset == str.size()) {
-    return;
-  }
-  for (size_t i = offset; i < str.size(); i++) {
-    if (!is_correct_digit(str[i])) {
-      throw std::invalid_argument("String initializer must contain only digits");
-    }
+  if (str == "-") {
+    throw std::invalid_argument("Wrong string initializer: \"-\"");
   }
-
-  for (size_t i = offset; i < str.length(); i += TEN_POWERS.size()) {
-    *this *= TEN_POWERS[std::min(TEN_POWERS.size() - 1, str.length() - i - 1)];
-    uint32_t cur_digit = std::stoi(str.substr(i, TEN_POWERS.size()));
-    *this += cur_digit;
+  std::from_chars_result result = from_chars(str.data(), str.data() + str.size(), *this, base, threads);
+  if (result.ec != std::errc() || result.ptr != str.data() + str.size()) {
+    throw std::invalid_argument("String initializer must contain only digits");
   }
-  is_negative = negative;
 }
 
 big_integer::~big_integer() = default;
 
-big_integer::big_integer(unsigned long long x) : is_negative(false) {
+big_integer::big_integer(unsigned long long x) {
   if (x == 0) {
     return;
   }
-  if (x < BASE) {
-    digits = {static_cast<uint32_t>(x)};
-  } else {
-    digits = {static_cast<uint32_t>(x % BASE), static_cast<uint32_t>(x / BASE)};
+  for (double_limb rest = x; rest != 0; rest >>= BASE_LOG2) {
+    digits.push_back(static_cast<limb>(rest));
   }
 }
 
 big_integer::big_integer(long long x) : big_integer(my_abs(x)) {
-  is_negative = (x < 0);
+  set_negative(x < 0);
 }
 
 big_integer::big_integer(int x) : big_integer(static_cast<long long>(x)) {}
@@ -144,168 +927,117 @@ uint64_t big_integer::my_abs(int64_t a) {
 }
 
 big_integer& big_integer::operator=(const big_integer& other) {
-  if (&other != this) {
-    big_integer(other).swap(*this);
-  }
+  // The limbs carry the sign and leave *this unchanged if copying them throws.
+  digits = other.digits;
   return *this;
 }
 
-big_integer& big_integer::operator+=(const big_integer& rhs) {
-  if (is_negative != rhs.is_negative) {
-    negate();
-    *this -= rhs;
-    negate();
+big_integer& big_integer::operator=(big_integer&& other) noexcept(std::is_nothrow_move_assignable_v<limbs>) {
+  digits = std::move(other.digits);
+  return *this;
+}
+
+void swap(big_integer& a, big_integer& b) noexcept(std::is_nothrow_swappable_v<big_integer::limbs>) {
+  a.swap(b);
+}
+
+// The writable pointer of *this is taken before rhs is read: if rhs is *this and its buffer is shared, that gives
+// *this a copy of its own, which rhs then also reads.
+void big_integer::add_abs(const big_integer& rhs) {
+  size_t n = size();
+  size_t m = rhs.size();
+  limb carry;
+  if (n >= m) {
+    limb* r = digits.data();
+    carry = add_limbs(r, r, n, rhs.digits.data(), m);
   } else {
-    digits.reserve(std::max(size(), rhs.size()) + 1);
-    uint8_t carry = 0;
-    for (size_t i = 0; i < std::max(size(), rhs.size()); ++i) {
-      uint64_t d1 = (i >= size() ? 0 : digits[i]);
-      uint64_t d2 = (i >= rhs.size() ? 0 : rhs.digits[i]);
-      if (i >= size()) {
-        digits.emplace_back((d1 + d2 + carry) & MASK);
-      } else {
-        digits[i] = (d1 + d2 + carry) & MASK;
-      }
-      carry = (d1 + d2 + carry) >= big_integer::BASE;
-    }
-    if (carry == 1) {
-      digits.emplace_back(carry);
-    }
+    digits.resize_for_overwrite(m);
+    limb* r = digits.data();
+    carry = add_limbs(r, rhs.digits.data(), m, r, n);
+  }
+  if (carry != 0) {
+    digits.emplace_back(carry);
   }
-  return *this;
 }
 
-big_integer& big_integer::operator+=(int64_t rhs) {
-  if (rhs < 0) {
-    return (*this -= -rhs);
+void big_integer::sub_abs(const big_integer& rhs) {
+  size_t n = size();
+  size_t m = rhs.size();
+  if (n > m || (n == m && cmp_n(std::as_const(digits).data(), rhs.digits.data(), n) >= 0)) {
+    limb* r = digits.data();
+    sub_limbs(r, r, n, rhs.digits.data(), m);
+  } else {
+    digits.resize_for_overwrite(m);
+    limb* r = digits.data();
+    sub_limbs(r, rhs.digits.data(), m, r, n);
+    set_negative(!negative());
   }
-  uint8_t carry;
-  if (*this >= ZERO) {
-    digits.reserve(digits.size() + 1);
-    for (size_t i = 0; i < size(); ++i) {
-      carry = (static_cast<uint64_t>(digits[i]) + static_cast<uint64_t>(rhs)) >= big_integer::BASE;
-      digits[i] += rhs;
-      rhs = carry;
-    }
-    if (rhs > 0) {
-      digits.emplace_back(rhs);
-    }
+  remove_leading_zeros(digits);
+  set_negative(negative() && !digits.empty());
+}
+
+big_integer& big_integer::operator+=(const big_integer& rhs) {
+  if (negative() == rhs.negative()) {
+    add_abs(rhs);
   } else {
-    if (size() == 1 && digits[0] < rhs) {
-      digits[0] = rhs - digits[0];
-      is_negative = false;
-    } else {
-      for (size_t i = 0; i < size(); ++i) {
-        carry = static_cast<uint64_t>(digits[i]) < static_cast<uint64_t>(rhs);
-        digits[i] -= rhs;
-        rhs = carry;
-      }
-      assert(rhs == 0);
-    }
+    sub_abs(rhs);
   }
   return *this;
 }
 
+big_integer& big_integer::operator+=(int64_t rhs) {
+  return *this += big_integer(rhs);
+}
+
 big_integer& big_integer::operator-=(const big_integer& rhs) {
-  if (is_negative != rhs.is_negative) {
-    negate();
-    *this += rhs;
-    negate();
+  if (negative() == rhs.negative()) {
+    sub_abs(rhs);
   } else {
-    digits.reserve(std::max(size(), rhs.size()) + 1);
-    bool new_sign = (*this < rhs);
-    bool greater = abs_greater(rhs);
-    uint64_t carry = 0;
-    for (size_t i = 0; i < std::max(size(), rhs.size()); ++i) {
-      uint64_t d1 = (i >= size() ? 0 : digits[i]);
-      uint64_t d2 = (i >= rhs.size() ? 0 : rhs.digits[i]);
-      if (greater) {
-        if (i >= size()) {
-          digits.emplace_back((d1 - d2 - carry + big_integer::BASE) % big_integer::BASE);
-        } else {
-          digits[i] = (d1 - d2 - carry + big_integer::BASE) % big_integer::BASE;
-        }
-        carry = (d1 < d2 + carry);
-      } else {
-        if (i >= size()) {
-          digits.emplace_back((d2 - d1 - carry + big_integer::BASE) % big_integer::BASE);
-        } else {
-          digits[i] = (d2 - d1 - carry + big_integer::BASE) % big_integer::BASE;
-        }
-        carry = (d2 < d1 + carry);
-      }
-    }
-    is_negative = new_sign;
-    assert(carry == 0);
-    big_integer::remove_leading_zeros(digits);
+    add_abs(rhs);
   }
   return *this;
 }
 
 big_integer& big_integer::operator-=(int64_t rhs) {
-  if (rhs == 0) {
-    return *this;
-  }
-  if (rhs < 0) {
-    return (*this += -rhs);
-  }
-  if (is_negative) {
-    negate();
-    *this += rhs;
-    negate();
-  } else {
-    bool new_sign = (*this < rhs);
-    bool greater = abs_greater(rhs);
-    for (size_t i = 0; i < size(); ++i) {
-      uint64_t d1 = (i >= size() ? 0 : digits[i]);
-      if (greater) {
-        digits[i] = (d1 - rhs + big_integer::BASE) % big_integer::BASE;
-        rhs = (d1 < rhs);
-      } else {
-        digits[i] = (rhs - d1 + big_integer::BASE) % big_integer::BASE;
-        rhs = (rhs < d1);
-      }
-    }
-    is_negative = new_sign;
-    assert(rhs == 0);
-    big_integer::remove_leading_zeros(digits);
-  }
-  return *this;
+  return *this -= big_integer(rhs);
 }
 
 big_integer& big_integer::operator*=(const big_integer& rhs) {
-  size_t prev_size = size();
-  digits.resize(size() + rhs.size());
-  for (size_t i = prev_size; i > 0; --i) {
-    for (size_t j = rhs.size(); j > 0; --j) {
-      uint64_t tmp = static_cast<uint64_t>(digits[i - 1]) * rhs.digits[j - 1];
-      if (j > 1) {
-        add_to_ith(i - 1 + j - 1, tmp & MASK);
-      } else {
-        digits[i - 1 + j - 1] = tmp & MASK;
-      }
-      add_to_ith(i - 1 + j - 1 + 1, tmp >> BASE_LOG2);
+  if (digits.empty() || rhs.digits.empty()) {
+    digits.clear();
+    set_negative(false);
+    return *this;
+  }
+  // Taken first: the swap below moves the sign of *this (and of rhs, if that is *this) into result.
+  bool product_negative = (negative() != rhs.negative());
+  size_t n = size() + rhs.size();
+  if (n <= 2 * BIG_INTEGER_INLINE_LIMBS) {
+    // Products of inline values are formed on the stack so that they stay allocation-free when they fit.
+    limb result[2 * BIG_INTEGER_INLINE_LIMBS];
+    mul_limbs(result, digits.data(), size(), rhs.digits.data(), rhs.size());
+    while (n > 0 && result[n - 1] == 0) {
+      --n;
     }
+    digits.assign(result, result + n);
+  } else {
+    limbs result(digits.get_allocator());
+    result.resize_for_overwrite(n);
+    mul_limbs(result.data(), std::as_const(digits).data(), size(), rhs.digits.data(), rhs.size());
+    remove_leading_zeros(result);
+    digits.swap(result);
   }
-
-  remove_leading_zeros(digits);
-  is_negative = (is_negative != rhs.is_negative);
-
+  set_negative(product_negative);
   return *this;
 }
 
 big_integer& big_integer::operator*=(int64_t rhs) {
-  digits.reserve(digits.size() + 1);
   uint64_t positive_rhs = my_abs(rhs);
-  uint64_t cur_digit = 0;
-  for (size_t i = 0; i < size(); i++) {
-    cur_digit += static_cast<uint64_t>(digits[i]) * positive_rhs;
-    digits[i] = cur_digit & MASK;
-    cur_digit >>= big_integer::BASE_LOG2;
+  if (positive_rhs > MASK || positive_rhs == 0) {
+    return *this *= big_integer(rhs);
   }
-  assert(cur_digit < big_integer::BASE);
-  if (cur_digit > 0) {
-    digits.emplace_back(cur_digit);
+  limb carry = mul_1(digits.data(), digits.data(), size(), static_cast<limb>(positive_rhs));
+  if (carry > 0) {
+    digits.emplace_back(carry);
   }
   if (rhs < 0) {
     negate();
@@ -314,14 +1046,12 @@ big_integer& big_integer::operator*=(int64_t rhs) {
 }
 
 big_integer& big_integer::operator/=(const big_integer& rhs) {
-  big_integer result = *this / rhs;
-  swap(result);
+  div_q(*this, *this, rhs);
   return *this;
 }
 
 big_integer& big_integer::operator%=(const big_integer& rhs) {
-  big_integer result = *this % rhs;
-  swap(result);
+  div_r(*this, *this, rhs);
   return *this;
 }
 
@@ -337,68 +1067,50 @@ bool big_integer::xor_negate_predicate(bool is_negative_lhs, bool is_negative_rh
   return is_negative_lhs ^ is_negative_rhs;
 }
 
-uint64_t big_integer::or_operation(uint64_t lhs, uint64_t rhs) {
+big_integer::limb big_integer::or_operation(limb lhs, limb rhs) {
   return lhs | rhs;
 }
 
-uint64_t big_integer::and_operation(uint64_t lhs, uint64_t rhs) {
+big_integer::limb big_integer::and_operation(limb lhs, limb rhs) {
   return lhs & rhs;
 }
 
-uint64_t big_integer::xor_operation(uint64_t lhs, uint64_t rhs) {
+big_integer::limb big_integer::xor_operation(limb lhs, limb rhs) {
   return lhs ^ rhs;
 }
 
-void big_integer::do_bitwise_operation(const big_integer& rhs, uint64_t (*operation)(uint64_t, uint64_t),
+void big_integer::do_bitwise_operation(const big_integer& rhs, limb (*operation)(limb, limb),
                                        bool (*negate_predicate)(bool, bool)) {
-  digits.reserve(std::max(size(), rhs.size()));
-  uint64_t add1 = is_negative, add2 = rhs.is_negative;
-  for (size_t i = 0; i < std::max(size(), rhs.size()) || add1 == 1 || add2 == 1; i++) {
-    uint64_t d1 = 0, d2 = 0;
-    if (i < size()) {
-      d1 = digits[i];
-    }
-    if (i < rhs.size()) {
-      d2 = rhs.digits[i];
-    }
-    if (is_negative) {
-      d1 = (~d1) & MASK;
-    }
-    if (rhs.is_negative) {
-      d2 = (~d2) & MASK;
-    }
-
-    if (add1 == 1) {
-      if (d1 == MASK) {
-        d1 = 0;
-      } else {
-        d1++;
-        add1 = 0;
-      }
+  // Both operands are streamed in two's complement (negation = complement + 1, the carries ripple up), which
+  // the result is converted back from. Beyond the longer operand both are sign extensions.
+  size_t k = size();
+  size_t n = std::max(k, rhs.size());
+  size_t m = rhs.size();
+  digits.resize_for_overwrite(n);
+  limb* r = digits.data();
+  const limb* b = rhs.digits.data();
+  limb carry1 = negative();
+  limb carry2 = rhs.negative();
+  const limb extend1 = negative() ? MASK : 0;
+  const limb extend2 = rhs.negative() ? MASK : 0;
+  for (size_t i = 0; i < n; ++i) {
+    limb d1 = ((i < k ? r[i] : 0) ^ extend1) + carry1;
+    carry1 &= (d1 == 0);
+    limb d2 = ((i < m ? b[i] : 0) ^ extend2) + carry2;
+    carry2 &= (d2 == 0);
+    r[i] = operation(d1, d2);
+  }
+  set_negative(negate_predicate(negative(), rhs.negative()));
+  if (negative()) {
+    // |result| = ~result + 1, which is 2^(n * BASE_LOG2) when every limb is zero.
+    for (size_t i = 0; i < n; ++i) {
+      r[i] = ~r[i];
     }
-
-    if (add2 == 1) {
-      if (d2 == MASK) {
-        d2 = 0;
-      } else {
-        d2++;
-        add2 = 0;
-      }
-    }
-
-    if (i >= size()) {
-      digits.emplace_back(d1 & d2);
-    } else {
-      digits[i] = operation(d1, d2);
+    if (add_1(r, r, n, 1) != 0) {
+      digits.emplace_back(1);
     }
   }
   big_integer::remove_leading_zeros(digits);
-  if (negate_predicate(is_negative, rhs.is_negative)) {
-    apply_additional_code();
-    is_negative = true;
-  } else {
-    is_negative = false;
-  }
 }
 
 big_integer& big_integer::operator&=(const big_integer& rhs) {
@@ -418,56 +1130,206 @@ big_integer& big_integer::operator^=(const big_integer& rhs) {
 
 big_integer& big_integer::operator<<=(int rhs) {
   assert(rhs >= 0);
-  if (*this == big_integer::ZERO) {
-    return *this;
-  }
-  uint8_t d = rhs % BASE_LOG2;
-  int tot = rhs / BASE_LOG2;
-  digits.reserve(digits.size() + tot + 1);
-  digits.insert(digits.begin(), tot, 0);
-  uint32_t prev = 0;
-  for (size_t c = 0; c < size(); ++c) {
-    uint32_t tmp = (static_cast<uint64_t>(digits[c]) << d) | prev;
-    prev = static_cast<uint64_t>(digits[c]) >> (BASE_LOG2 - d);
-    digits[c] = tmp;
-  }
-  digits.emplace_back(prev);
-  remove_leading_zeros(digits);
+  mul_2exp(*this, *this, rhs);
   return *this;
 }
 
 big_integer& big_integer::operator>>=(int rhs) {
   assert(rhs >= 0);
-  bool sub = false;
-  uint64_t d = rhs % BASE_LOG2;
-  int tot = rhs / BASE_LOG2;
-  for (size_t i = 0; i < std::min(static_cast<int>(size()), tot); ++i) {
-    if (digits[i] != 0) {
-      sub = true;
+  fdiv_q_2exp(*this, *this, rhs);
+  return *this;
+}
+
+void mul_2exp(big_integer& r, const big_integer& a, uint64_t bits) {
+  if (a.digits.empty()) {
+    r.digits.clear();
+    r.set_negative(false);
+    return;
+  }
+  size_t n = a.size();
+  size_t limbs = bits / big_integer::BASE_LOG2;
+  int shift = bits % big_integer::BASE_LOG2;
+  bool negative = a.negative();
+  bool grows = (shift != 0 && (a.digits.back() >> (big_integer::BASE_LOG2 - shift)) != 0);
+  // Single resize; when r is a the old limbs stay at the bottom and are moved up in place.
+  r.digits.resize_for_overwrite(n + limbs + grows);
+  limb* data = r.digits.data();
+  limb top = shift_left_limbs(data + limbs, a.digits.data(), n, shift);
+  if (grows) {
+    data[n + limbs] = top;
+  }
+  std::fill_n(data, limbs, 0);
+  r.set_negative(negative);
+}
+
+void big_integer::shift_right_impl(big_integer& q, const big_integer& a, uint64_t bits, bool round_down) {
+  size_t n = a.size();
+  bool negative = a.negative();
+  if (bits / BASE_LOG2 >= n) {
+    // Every bit is shifted out: 0, or -1 when rounding a negative number towards -inf.
+    bool minus_one = round_down && negative;
+    q.digits.assign(minus_one ? 1 : 0, 1);
+    q.set_negative(minus_one);
+    return;
+  }
+  size_t limbs = bits / BASE_LOG2;
+  int shift = bits % BASE_LOG2;
+  // Floor of a negative number is one more in magnitude if any shifted-out bit is set.
+  bool round_up = round_down && negative &&
+                  (std::any_of(a.digits.begin(), a.digits.begin() + limbs, [](limb x) { return x != 0; }) ||
+                   (a.digits[limbs] & ((limb(1) << shift) - 1)) != 0);
+  size_t new_size = n - limbs;
+  if (&q != &a) {
+    q.digits.resize_for_overwrite(new_size);
+  }
+  limb* r = q.digits.data();
+  shift_right_limbs(r, a.digits.data() + limbs, new_size, shift);
+  q.digits.resize(new_size);
+  remove_leading_zeros(q.digits);
+  if (round_up) {
+    q.add_to_ith(0, 1);
+  }
+  q.set_negative(negative && !q.digits.empty());
+}
+
+void fdiv_q_2exp(big_integer& q, const big_integer& a, uint64_t bits) {
+  big_integer::shift_right_impl(q, a, bits, true);
+}
+
+void tdiv_q_2exp(big_integer& q, const big_integer& a, uint64_t bits) {
+  big_integer::shift_right_impl(q, a, bits, false);
+}
+
+void mod_2exp(big_integer& r, const big_integer& a, uint64_t bits) {
+  size_t n = a.size();
+  size_t limbs = bits / big_integer::BASE_LOG2 + (bits % big_integer::BASE_LOG2 != 0);
+  limb top_mask = (bits % big_integer::BASE_LOG2 == 0 ? big_integer::MASK
+                                                      : (limb(1) << (bits % big_integer::BASE_LOG2)) - 1);
+  bool negative = a.negative();
+  size_t kept = std::min(n, limbs);
+  if (&r != &a) {
+    r.digits.assign(a.digits.begin(), a.digits.begin() + kept);
+  }
+  if (negative) {
+    // 2^bits - (|a| mod 2^bits): two's complement of the low limbs, sign-extended to the full width.
+    r.digits.resize(limbs);
+    for (size_t i = 0; i < limbs; ++i) {
+      r.digits[i] = ~r.digits[i];
+    }
+    add_1(r.digits.data(), r.digits.data(), limbs, 1);
+  } else {
+    r.digits.resize(kept);
+  }
+  if (r.digits.size() == limbs && limbs > 0) {
+    r.digits.back() &= top_mask;
+  }
+  big_integer::remove_leading_zeros(r.digits);
+  r.set_negative(false);
+}
+
+void big_integer::add_product(const big_integer& a, const big_integer& b, bool subtract) {
+  const big_integer* x = &a;
+  const big_integer* y = &b;
+  if (x->size() < y->size()) {
+    std::swap(x, y);
+  }
+  size_t na = x->size();
+  size_t nb = y->size();
+  if (nb == 0) {
+    return;
+  }
+  bool product_negative = (a.negative() != b.negative()) != subtract;
+  size_t n = size();
+  if (n == 0) {
+    // Then neither factor is *this, and the product goes straight into its limbs.
+    digits.resize_for_overwrite(na + nb);
+    mul_limbs(digits.data(), x->digits.data(), na, y->digits.data(), nb);
+    remove_leading_zeros(digits);
+    set_negative(product_negative);
+    return;
+  }
+  bool same_sign = (product_negative == negative());
+
+  if (nb == 1 && (same_sign || n > na)) {
+    // Fused: |*this| +- |x| * factor in place. The writable pointer is taken before x is read (see add_abs).
+    limb factor = y->digits[0];
+    if (n < na) {
+      digits.resize(na);
+    }
+    limb* r = digits.data();
+    const limb* xp = x->digits.data();
+    if (same_sign) {
+      limb carry = addmul_1(r, xp, na, factor);
+      carry = add_1(r + na, r + na, std::max(n, na) - na, carry);
+      if (carry != 0) {
+        digits.emplace_back(carry);
+      }
+      return;
+    }
+    // The product has fewer limbs than *this, so at most one borrow leaves it: then |*this| < |product|, and r holds
+    // their difference plus 2^(n * LIMB_BITS), which is negated in place.
+    limb borrow = submul_1(r, xp, na, factor);
+    if (sub_1(r + na, r + na, n - na, borrow) != 0) {
+      for (size_t i = 0; i < n; ++i) {
+        r[i] = ~r[i];
+      }
+      add_1(r, r, n, 1);
+      set_negative(!negative());
+    }
+    remove_leading_zeros(digits);
+    set_negative(negative() && !digits.empty());
+    return;
+  }
+
+  scratch_frame scratch;
+  scratch.reserve(na + nb + 4 * na + 16 * std::bit_width(na));
+  limb* p = scratch.allocate(na + nb);
+  mul_limbs(p, x->digits.data(), na, y->digits.data(), nb);
+  size_t np = na + nb - (p[na + nb - 1] == 0);
+  if (same_sign) {
+    limb carry;
+    if (n >= np) {
+      limb* r = digits.data();
+      carry = add_limbs(r, r, n, p, np);
+    } else {
+      digits.resize_for_overwrite(np);
+      limb* r = digits.data();
+      carry = add_limbs(r, p, np, r, n);
+    }
+    if (carry != 0) {
+      digits.emplace_back(carry);
     }
+    return;
   }
-  if (tot >= size()) {
-    digits.clear();
+  if (n > np || (n == np && cmp_n(std::as_const(digits).data(), p, n) >= 0)) {
+    limb* r = digits.data();
+    sub_limbs(r, r, n, p, np);
   } else {
-    digits.erase(digits.begin(), digits.begin() + tot);
+    digits.resize_for_overwrite(np);
+    limb* r = digits.data();
+    sub_limbs(r, p, np, r, n);
+    set_negative(!negative());
   }
-  sub = (sub | (first_digit() % (1u << d) != 0)) && is_negative; // Очень странное условие на вычет единицы
+  remove_leading_zeros(digits);
+  set_negative(negative() && !digits.empty());
+}
 
-  *this /= 1u << d;
-  if (sub) {
-    (*this)--;
-  }
-  return *this;
+void addmul(big_integer& r, const big_integer& a, const big_integer& b) {
+  r.add_product(a, b, false);
+}
+
+void submul(big_integer& r, const big_integer& a, const big_integer& b) {
+  r.add_product(a, b, true);
 }
 
 big_integer big_integer::operator+() const {
-  return *this;
+  return big_integer(std::allocator_arg, get_allocator(), *this);
 }
 
 big_integer big_integer::operator-() const {
-  big_integer result = *this;
+  big_integer result(std::allocator_arg, get_allocator(), *this);
   if (result != big_integer::ZERO) {
-    result.is_negative ^= 1;
+    result.set_negative(!result.negative());
   }
   return result;
 }
@@ -484,7 +1346,7 @@ big_integer& big_integer::operator++() {
 }
 
 big_integer big_integer::operator++(int) {
-  big_integer result = *this;
+  big_integer result(std::allocator_arg, get_allocator(), *this);
   ++(*this);
   return result;
 }
@@ -495,184 +1357,422 @@ big_integer& big_integer::operator--() {
 }
 
 big_integer big_integer::operator--(int) {
-  big_integer result = *this;
+  big_integer result(std::allocator_arg, get_allocator(), *this);
   --(*this);
   return result;
 }
 
 big_integer operator+(const big_integer& lhs, const big_integer& rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp += rhs;
   return tmp;
 }
 
 big_integer operator+(const big_integer& lhs, int64_t rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp += rhs;
   return tmp;
 }
 
 big_integer operator+(int64_t lhs, const big_integer& rhs) {
-  big_integer tmp(rhs);
+  big_integer tmp(std::allocator_arg, rhs.get_allocator(), rhs);
   tmp += lhs;
   return tmp;
 }
 
 big_integer operator-(const big_integer& lhs, const big_integer& rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp -= rhs;
   return tmp;
 }
 
 big_integer operator-(const big_integer& lhs, int64_t rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp -= rhs;
   return tmp;
 }
 
 big_integer operator-(int64_t lhs, const big_integer& rhs) {
-  big_integer tmp(rhs);
+  big_integer tmp(std::allocator_arg, rhs.get_allocator(), rhs);
   tmp -= lhs;
+  tmp.negate();
   return tmp;
 }
 
 big_integer operator*(const big_integer& lhs, const big_integer& rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp *= rhs;
   return tmp;
 }
 
 big_integer operator*(const big_integer& lhs, int64_t rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp *= rhs;
   return tmp;
 }
 
 big_integer operator*(int64_t lhs, const big_integer& rhs) {
-  big_integer tmp(rhs);
+  big_integer tmp(std::allocator_arg, rhs.get_allocator(), rhs);
   tmp *= lhs;
   return tmp;
 }
 
-std::pair<big_integer, big_integer> div_mod(const big_integer& lhs, uint32_t rhs) {
-  if (lhs < rhs) {
-    return {0, lhs};
-  }
-  uint64_t acc = 0;
-  std::vector<uint32_t> result;
-  result.reserve(lhs.size());
-  for (size_t i = lhs.size(); i > 0; i--) {
-    acc <<= big_integer::BASE_LOG2;
-    acc += lhs.digits[i - 1];
-    if (acc >= rhs) {
-      uint64_t l = acc / rhs;
-      result.emplace_back(l);
-      acc -= l * rhs;
-    } else {
-      result.emplace_back(0);
-    }
+bool big_integer::lends_buffer(const big_integer& lhs, const big_integer& rhs) noexcept {
+  return lhs.get_allocator() == rhs.get_allocator();
+}
+
+bool big_integer::lends_larger_buffer(const big_integer& lhs, const big_integer& rhs) noexcept {
+  return rhs.digits.capacity() > lhs.digits.capacity() && lends_buffer(lhs, rhs);
+}
+
+big_integer operator+(big_integer&& lhs, const big_integer& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+big_integer operator+(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs + std::as_const(rhs);
+  }
+  rhs += lhs;
+  return std::move(rhs);
+}
+
+big_integer operator+(big_integer&& lhs, big_integer&& rhs) {
+  if (big_integer::lends_larger_buffer(lhs, rhs)) {
+    rhs += lhs;
+    return std::move(rhs);
   }
-  std::reverse(result.begin(), result.end());
-  big_integer::remove_leading_zeros(result);
-  return {big_integer(result), acc};
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+big_integer operator+(big_integer&& lhs, int64_t rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+big_integer operator+(int64_t lhs, big_integer&& rhs) {
+  rhs += lhs;
+  return std::move(rhs);
+}
+
+big_integer operator-(big_integer&& lhs, const big_integer& rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
 }
 
-std::pair<big_integer, big_integer> div_mod(const big_integer& lhs, const big_integer& rhs) {
-  int k = 0;
-  big_integer a = lhs;
-  big_integer b = rhs;
-  if (a < 0) {
-    a.negate();
+// lhs - rhs is computed in the buffer of rhs as -(rhs - lhs).
+big_integer operator-(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs - std::as_const(rhs);
   }
-  if (b < 0) {
-    b.negate();
+  rhs -= lhs;
+  rhs.negate();
+  return std::move(rhs);
+}
+
+big_integer operator-(big_integer&& lhs, big_integer&& rhs) {
+  if (big_integer::lends_larger_buffer(lhs, rhs)) {
+    rhs -= lhs;
+    rhs.negate();
+    return std::move(rhs);
   }
-  if (a < b) {
-    if (lhs.is_negative) {
-      a.negate();
-    }
-    return {0, a};
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator-(big_integer&& lhs, int64_t rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator-(int64_t lhs, big_integer&& rhs) {
+  rhs -= lhs;
+  rhs.negate();
+  return std::move(rhs);
+}
+
+big_integer operator*(big_integer&& lhs, const big_integer& rhs) {
+  lhs *= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator*(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs * std::as_const(rhs);
   }
-  uint32_t last_digit = b.digits.back();
-  while (last_digit < big_integer::BASE / 2) {
-    ++k;
-    last_digit <<= 1;
+  rhs *= lhs;
+  return std::move(rhs);
+}
+
+big_integer operator*(big_integer&& lhs, big_integer&& rhs) {
+  if (big_integer::lends_larger_buffer(lhs, rhs)) {
+    rhs *= lhs;
+    return std::move(rhs);
   }
-  a <<= k;
-  b <<= k;
-  int n = b.size();
-  int m = a.size() - n;
-  big_integer q;
-  q.digits.resize(m + 1);
-  if (a >= (b << (big_integer::BASE_LOG2 * m))) {
-    q.digits[m] = 1;
-    a -= (b << (big_integer::BASE_LOG2 * m));
-  } else {
-    q.digits[m] = 0;
+  lhs *= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator*(big_integer&& lhs, int64_t rhs) {
+  lhs *= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator*(int64_t lhs, big_integer&& rhs) {
+  rhs *= lhs;
+  return std::move(rhs);
+}
+
+void big_integer::divmod_impl(big_integer* q, big_integer* r, const big_integer& a, const big_integer& b,
+                              rounding mode) {
+  assert(q != r);
+  if (b.digits.empty()) {
+    throw std::domain_error("Division by zero");
   }
-  for (int j = m - 1; j >= 0; j--) {
-    uint64_t d1 = (n + j < a.size() ? a.digits[n + j] : 0);
-    uint64_t d2 = (n + j - 1 < a.size() ? a.digits[n + j - 1] : 0);
-    q.digits[j] = (d1 * big_integer::BASE + d2) / b.digits[n - 1];
-    q.digits[j] = std::min(q.digits[j], static_cast<uint32_t>(big_integer::BASE - 1));
-    a -= ((q.digits[j] * b) << (big_integer::BASE_LOG2 * j));
-    while (a < 0) {
-      q.digits[j]--;
-      a += (b << (big_integer::BASE_LOG2 * j));
+  // Everything needed from a and b is captured (signs) or copied (normalized limbs) before
+  // q or r is touched, so either of them may alias a or b.
+  bool a_negative = a.negative();
+  bool b_negative = b.negative();
+  size_t na = a.size();
+  size_t n = b.size();
+  int shift = std::countl_zero(b.digits.back());
+
+  // Normalized copies: on the stack for operands that are stored inline, in the scratch arena otherwise.
+  scratch_frame scratch;
+  limb vn_inline[BIG_INTEGER_INLINE_LIMBS + 1];
+  limb un_inline[BIG_INTEGER_INLINE_LIMBS + 1];
+  size_t nu = std::max(na, n) + 1;
+  bool fits_inline = (nu <= BIG_INTEGER_INLINE_LIMBS + 1);
+  if (!fits_inline) {
+    scratch.reserve(n + nu);
+  }
+  limb* vn = (fits_inline ? vn_inline : scratch.allocate(n));
+  limb* un = (fits_inline ? un_inline : scratch.allocate(nu));
+  shift_left_limbs(vn, b.digits.data(), n, shift);
+  un[na] = shift_left_limbs(un, a.digits.data(), na, shift);
+  std::fill(un + na + 1, un + nu, 0);
+
+  limb* quotient = nullptr;
+  if (q != nullptr) {
+    q->digits.assign(na >= n ? na - n + 1 : 0, 0);
+    quotient = q->digits.data();
+  }
+  if (na >= n) {
+    if (n == 1) {
+      un[0] = divmod_limb(quotient, un, na, un[na], vn[0]);
+    } else {
+      div_limbs(quotient, un, na + 1, vn, n);
+    }
+  }
+
+  bool remainder_zero = std::all_of(un, un + n, [](limb x) { return x == 0; });
+  bool adjust = false;
+  if (!remainder_zero) {
+    switch (mode) {
+    case rounding::trunc:
+      break;
+    case rounding::floor:
+      adjust = (a_negative != b_negative);
+      break;
+    case rounding::ceil:
+      adjust = (a_negative == b_negative);
+      break;
+    case rounding::euclid:
+      adjust = a_negative;
+      break;
     }
   }
-  big_integer::remove_leading_zeros(q.digits);
-  if (lhs.is_negative != rhs.is_negative) {
-    q.negate();
+
+  // Rounding away from zero turns (Q, R) into (Q + 1, |b| - R); the remainder then takes the sign opposite to a.
+  if (q != nullptr) {
+    if (adjust) {
+      q->add_to_ith(0, 1);
+    }
+    remove_leading_zeros(q->digits);
+    q->set_negative((a_negative != b_negative) && !q->digits.empty());
   }
-  if (lhs.is_negative) {
-    a.negate();
+  if (r != nullptr) {
+    if (adjust) {
+      sub_n(un, vn, un, n);
+    }
+    r->digits.resize_for_overwrite(n);
+    shift_right_limbs(r->digits.data(), un, n, shift);
+    remove_leading_zeros(r->digits);
+    r->set_negative((a_negative != adjust) && !r->digits.empty());
   }
-  return {q, a >> k};
+}
+
+void divmod(big_integer& q, big_integer& r, const big_integer& a, const big_integer& b, big_integer::rounding mode) {
+  big_integer::divmod_impl(&q, &r, a, b, mode);
+}
+
+void div_q(big_integer& q, const big_integer& a, const big_integer& b, big_integer::rounding mode) {
+  big_integer::divmod_impl(&q, nullptr, a, b, mode);
+}
+
+void div_r(big_integer& r, const big_integer& a, const big_integer& b, big_integer::rounding mode) {
+  big_integer::divmod_impl(nullptr, &r, a, b, mode);
 }
 
 big_integer operator/(const big_integer& lhs, const big_integer& rhs) {
-  std::pair<big_integer, big_integer> result = div_mod(lhs, rhs);
-  return result.first;
+  big_integer result(std::allocator_arg, lhs.get_allocator());
+  div_q(result, lhs, rhs);
+  return result;
 }
 
 big_integer operator%(const big_integer& lhs, const big_integer& rhs) {
-  std::pair<big_integer, big_integer> result = div_mod(lhs, rhs);
-  return result.second;
+  big_integer result(std::allocator_arg, lhs.get_allocator());
+  div_r(result, lhs, rhs);
+  return result;
+}
+
+// The quotient and the remainder may alias either operand.
+big_integer operator/(big_integer&& lhs, const big_integer& rhs) {
+  div_q(lhs, lhs, rhs);
+  return std::move(lhs);
+}
+
+big_integer operator/(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs / std::as_const(rhs);
+  }
+  div_q(rhs, lhs, rhs);
+  return std::move(rhs);
+}
+
+big_integer operator/(big_integer&& lhs, big_integer&& rhs) {
+  return std::move(lhs) / std::as_const(rhs);
+}
+
+big_integer operator%(big_integer&& lhs, const big_integer& rhs) {
+  div_r(lhs, lhs, rhs);
+  return std::move(lhs);
+}
+
+big_integer operator%(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs % std::as_const(rhs);
+  }
+  div_r(rhs, lhs, rhs);
+  return std::move(rhs);
+}
+
+big_integer operator%(big_integer&& lhs, big_integer&& rhs) {
+  return std::move(lhs) % std::as_const(rhs);
 }
 
 big_integer operator&(const big_integer& lhs, const big_integer& rhs) {
-  big_integer tmp(lhs);
+  big_integer tmp(std::allocator_arg, lhs.get_allocator(), lhs);
   tmp &= rhs;
   return tmp;
 }
 
 big_integer operator|(const big_integer& a, const big_integer& b) {
-  big_integer tmp(a);
+  big_integer tmp(std::allocator_arg, a.get_allocator(), a);
   tmp |= b;
   return tmp;
 }
 
 big_integer operator^(const big_integer& a, const big_integer& b) {
-  big_integer tmp(a);
+  big_integer tmp(std::allocator_arg, a.get_allocator(), a);
   tmp ^= b;
   return tmp;
 }
 
+big_integer operator&(big_integer&& lhs, const big_integer& rhs) {
+  lhs &= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator&(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs & std::as_const(rhs);
+  }
+  rhs &= lhs;
+  return std::move(rhs);
+}
+
+big_integer operator&(big_integer&& lhs, big_integer&& rhs) {
+  if (big_integer::lends_larger_buffer(lhs, rhs)) {
+    rhs &= lhs;
+    return std::move(rhs);
+  }
+  lhs &= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator|(big_integer&& lhs, const big_integer& rhs) {
+  lhs |= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator|(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs | std::as_const(rhs);
+  }
+  rhs |= lhs;
+  return std::move(rhs);
+}
+
+big_integer operator|(big_integer&& lhs, big_integer&& rhs) {
+  if (big_integer::lends_larger_buffer(lhs, rhs)) {
+    rhs |= lhs;
+    return std::move(rhs);
+  }
+  lhs |= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator^(big_integer&& lhs, const big_integer& rhs) {
+  lhs ^= rhs;
+  return std::move(lhs);
+}
+
+big_integer operator^(const big_integer& lhs, big_integer&& rhs) {
+  if (!big_integer::lends_buffer(lhs, rhs)) {
+    return lhs ^ std::as_const(rhs);
+  }
+  rhs ^= lhs;
+  return std::move(rhs);
+}
+
+big_integer operator^(big_integer&& lhs, big_integer&& rhs) {
+  if (big_integer::lends_larger_buffer(lhs, rhs)) {
+    rhs ^= lhs;
+    return std::move(rhs);
+  }
+  lhs ^= rhs;
+  return std::move(lhs);
+}
+
 big_integer operator<<(const big_integer& a, int b) {
-  big_integer tmp(a);
-  tmp <<= b;
+  assert(b >= 0);
+  big_integer tmp(std::allocator_arg, a.get_allocator());
+  mul_2exp(tmp, a, b);
   return tmp;
 }
 
 big_integer operator>>(const big_integer& a, int b) {
-  big_integer tmp(a);
-  tmp >>= b;
+  assert(b >= 0);
+  big_integer tmp(std::allocator_arg, a.get_allocator());
+  fdiv_q_2exp(tmp, a, b);
   return tmp;
 }
 
+big_integer operator<<(big_integer&& a, int b) {
+  a <<= b;
+  return std::move(a);
+}
+
+big_integer operator>>(big_integer&& a, int b) {
+  a >>= b;
+  return std::move(a);
+}
+
 bool operator==(const big_integer& a, const big_integer& b) {
-  return a.digits == b.digits && a.is_negative == b.is_negative;
+  return a.digits == b.digits && a.negative() == b.negative();
 }
 
 bool operator!=(const big_integer& a, const big_integer& b) {
@@ -680,13 +1780,13 @@ bool operator!=(const big_integer& a, const big_integer& b) {
 }
 
 bool operator<(const big_integer& a, const big_integer& b) {
-  if (a.is_negative != b.is_negative) {
-    return a.is_negative;
+  if (a.negative() != b.negative()) {
+    return a.negative();
   }
   if (a.size() != b.size()) {
-    return (a.size() > b.size()) == a.is_negative;
+    return (a.size() > b.size()) == a.negative();
   }
-  if (!a.is_negative) {
+  if (!a.negative()) {
     return std::lexicographical_compare(a.digits.rbegin(), a.digits.rend(), b.digits.rbegin(), b.digits.rend());
   } else {
     return std::lexicographical_compare(a.digits.rbegin(), a.digits.rend(), b.digits.rbegin(), b.digits.rend(),
@@ -706,38 +1806,657 @@ bool operator>=(const big_integer& a, const big_integer& b) {
   return !(a < b);
 }
 
-std::string to_string(const big_integer& a) {
-  if (a == big_integer::ZERO) {
-    return "0";
+const big_integer& big_integer::chunk_power(int base, size_t k) {
+  cached_powers& cache = POWER_CACHE[base];
+  if (const big_integer* power = cache.levels[k].load(std::memory_order_acquire)) {
+    return *power;
+  }
+  std::lock_guard lock(cache.growth);
+  for (size_t i = 0; i <= k; ++i) {
+    if (cache.levels[i].load(std::memory_order_relaxed) == nullptr) {
+      const big_integer* power =
+          (i == 0 ? new big_integer(std::allocator_arg, power_cache_allocator(), RADIXES[base].chunk)
+                  : new big_integer(std::allocator_arg, power_cache_allocator(),
+                                    *cache.levels[i - 1].load(std::memory_order_relaxed) *
+                                        *cache.levels[i - 1].load(std::memory_order_relaxed)));
+      cache.levels[i].store(power, std::memory_order_release);
+    }
+  }
+  return *cache.levels[k].load(std::memory_order_relaxed);
+}
+
+void big_integer::prewarm_power_cache(size_t digits, int base) {
+  if (base < 2 || base > 36) {
+    throw std::invalid_argument("Base must be in range [2, 36]");
+  }
+  const radix_info& radix = RADIXES[base];
+  if (radix.log2 == 0) {
+    // Conversions of n digits use levels up to bit_width((n - 1) / d) - 1.
+    size_t chunks = (digits > radix.chunk_digits ? (digits - 1) / radix.chunk_digits : 1);
+    chunk_power(base, std::bit_width(chunks) - 1);
+  }
+}
+
+void big_integer::clear_power_cache() {
+  for (cached_powers& cache : POWER_CACHE) {
+    std::lock_guard lock(cache.growth);
+    for (std::atomic<const big_integer*>& level : cache.levels) {
+      delete level.exchange(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
+
+big_integer big_integer::read_digits(const char* first, size_t length, int base) {
+  const radix_info& radix = RADIXES[base];
+  if (radix.log2 != 0) {
+    big_integer result;
+    result.digits.resize_for_overwrite((length * radix.log2 + BASE_LOG2 - 1) / BASE_LOG2);
+    read_pow2_digits(result.digits.data(), first, length, radix.log2);
+    remove_leading_zeros(result.digits);
+    return result;
   }
-  big_integer b = a;
-  std::vector<std::string> digits;
-  bool negative = b.is_negative;
-  if (b.is_negative) {
-    b.negate();
-  }
-  while (b != big_integer::ZERO) {
-    std::pair<big_integer, big_integer> tmp = div_mod(b, big_integer::TEN_POWERS.back());
-    b.swap(tmp.first);
-    std::string str = std::to_string(tmp.second.first_digit());
-    if (b != 0) {
-      digits.emplace_back(big_integer::TEN_POWERS.size() - str.size(), '0');
-      digits.back() += str;
+  if (length <= FROM_STRING_THRESHOLD * radix.chunk_digits) {
+    // Horner's scheme, the shortest group of digits goes first and each group is folded in with single-limb
+    // multiply-adds. Decimal digits are read in groups of 18 (two chunks), other bases one chunk at a time.
+    big_integer result;
+    result.digits.reserve(length / radix.chunk_digits + 1);
+    auto fold = [&result](limb scale, limb chunk) {
+      limb carry = mul_1(result.digits.data(), result.digits.data(), result.size(), scale, chunk);
+      if (carry != 0) {
+        result.digits.push_back(carry);
+      }
+    };
+    if (base == 10) {
+      const size_t group = 2 * DECIMAL_CHUNK_DIGITS;
+      size_t head = (length % group == 0 ? group : length % group);
+      for (size_t i = 0; i < length; i += head, head = group) {
+        uint64_t value = read_decimal_group(first + i, head);
+        if (head > DECIMAL_CHUNK_DIGITS) {
+          fold(TEN_POWERS[head - DECIMAL_CHUNK_DIGITS], static_cast<uint32_t>(value / DECIMAL_CHUNK));
+          fold(DECIMAL_CHUNK, static_cast<uint32_t>(value % DECIMAL_CHUNK));
+        } else {
+          fold(TEN_POWERS[head], static_cast<uint32_t>(value));
+        }
+      }
     } else {
-      digits.emplace_back(str);
+      size_t head = (length % radix.chunk_digits == 0 ? radix.chunk_digits : length % radix.chunk_digits);
+      uint32_t scale = 1;
+      for (size_t i = 0; i < head; ++i) {
+        scale *= radix.base;
+      }
+      for (size_t i = 0; i < length; i += head, head = radix.chunk_digits, scale = radix.chunk) {
+        fold(scale, read_chunk(first + i, head, radix.base));
+      }
     }
+    return result;
   }
-  std::string result;
-  if (negative) {
-    result += "-";
+  // The low part takes d * 2^k digits, at least half of the string: value = high * base^(d * 2^k) + low,
+  // d = chunk_digits.
+  size_t k = std::bit_width((length - 1) / radix.chunk_digits) - 1;
+  size_t low_length = radix.chunk_digits << k;
+  big_integer result = read_digits(first, length - low_length, base);
+  result *= chunk_power(base, k);
+  result += read_digits(first + length - low_length, low_length, base);
+  return result;
+}
+
+big_integer big_integer::read_digits_parallel(const char* first, size_t length, int base, unsigned threads) {
+  const radix_info& radix = RADIXES[base];
+  if (threads <= 1 || radix.log2 != 0 || length < PARALLEL_THRESHOLD * radix.chunk_digits) {
+    return read_digits(first, length, base);
+  }
+  // Same split as read_digits(); the high part is read on a new thread.
+  size_t k = std::bit_width((length - 1) / radix.chunk_digits) - 1;
+  size_t low_length = radix.chunk_digits << k;
+  std::future<big_integer> high =
+      std::async(std::launch::async, read_digits_parallel, first, length - low_length, base, threads / 2);
+  big_integer low = read_digits_parallel(first + length - low_length, low_length, base, threads - threads / 2);
+  big_integer result = high.get();
+  result *= chunk_power(base, k);
+  result += low;
+  return result;
+}
+
+// Digits of |x| laid out for output. For power-of-two bases they are sliced straight out of the limbs.
+// Otherwise, with P[l] = base^(d * 2^l) and d = chunk_digits,
+// |x| = (...((head * P[l_k] + t_k) * P[l_(k-1)] + t_(k-1)) ...) * P[l_1] + t_1,
+// where head is below TO_STRING_THRESHOLD limbs and each t_i takes exactly d * 2^l_i digits with leading zeros.
+// Splitting off the tails costs O(M(n)) and gives the exact length before anything is written.
+struct big_integer::radix_layout {
+  const big_integer& x;
+  const radix_info& radix;
+  uint32_t head[MAX_BASECASE_CHUNKS];
+  size_t head_chunks = 0;
+  std::vector<std::pair<big_integer, int>> tails;
+  size_t length = 0;
+
+  // x must not be zero.
+  radix_layout(const big_integer& x, int base) : x(x), radix(RADIXES[base]) {
+    if (radix.log2 != 0) {
+      size_t bits = x.size() * BASE_LOG2 - std::countl_zero(x.digits.back());
+      length = (bits + radix.log2 - 1) / radix.log2;
+      return;
+    }
+    // Signs are ignored: the truncating division below yields the magnitudes of quotient and remainder.
+    const big_integer* rest = &x;
+    big_integer q;
+    while (rest->size() >= TO_STRING_THRESHOLD) {
+      // Split by the largest P[k] not exceeding |rest|, so that the quotient is below that power too.
+      // P[k + 1] has at least 2 * |P[k]| - 1 limbs, so it is only looked at when it may still fit.
+      int split = 0;
+      while (2 * chunk_power(radix.base, split).size() - 1 <= rest->size()) {
+        const big_integer& next = chunk_power(radix.base, split + 1);
+        if (next.size() > rest->size() ||
+            (next.size() == rest->size() && cmp_n(next.digits.data(), rest->digits.data(), rest->size()) > 0)) {
+          break;
+        }
+        ++split;
+      }
+      tails.emplace_back(big_integer(), split);
+      divmod(q, tails.back().first, *rest, chunk_power(radix.base, split));
+      length += radix.chunk_digits << split;
+      rest = &q;
+    }
+    head_chunks = radix_chunks(head, rest->digits.data(), rest->size(), radix.chunk);
+    length += (head_chunks - 1) * radix.chunk_digits + short_length(head[head_chunks - 1], radix.base);
+  }
+
+  // Writes exactly `length` characters; large tails are split between up to `threads` threads.
+  char* write(char* out, unsigned threads = 1) {
+    if (radix.log2 != 0) {
+      write_pow2_digits(out, length, x.digits.data(), x.size(), radix.log2);
+      return out + length;
+    }
+    out = write_short(out, head[head_chunks - 1], radix.base);
+    for (size_t i = head_chunks - 1; i > 0; --i) {
+      write_chunk(out, head[i - 1], radix);
+      out += radix.chunk_digits;
+    }
+    for (size_t i = tails.size(); i > 0; --i) {
+      out = write_digits_parallel(out, tails[i - 1].first, tails[i - 1].second, radix.base, threads);
+    }
+    return out;
+  }
+
+  // Writes the same characters to the stream block by block, without materializing all of them.
+  void write(std::ostream& out, bool uppercase) {
+    std::string block(radix.chunk_digits << STREAM_BLOCK_LEVEL, '\0');
+    auto flush = [&](char* end) {
+      if (uppercase && radix.base > 10) {
+        std::transform(block.data(), end, block.data(), [](char c) { return c >= 'a' ? char(c - 'a' + 'A') : c; });
+      }
+      out.write(block.data(), end - block.data());
+    };
+    if (radix.log2 != 0) {
+      for (size_t done = 0; done < length;) {
+        size_t count = std::min(block.size(), length - done);
+        done += count;
+        write_pow2_digits(block.data(), count, x.digits.data(), x.size(), radix.log2, (length - done) * radix.log2);
+        flush(block.data() + count);
+      }
+      return;
+    }
+    char* end = write_short(block.data(), head[head_chunks - 1], radix.base);
+    for (size_t i = head_chunks - 1; i > 0; --i) {
+      write_chunk(end, head[i - 1], radix);
+      end += radix.chunk_digits;
+    }
+    flush(end);
+    auto write_tail = [&](auto& self, const big_integer& t, int level) -> void {
+      if (level <= STREAM_BLOCK_LEVEL) {
+        flush(write_digits(block.data(), t, level, radix.base));
+        return;
+      }
+      big_integer q;
+      big_integer r;
+      divmod(q, r, t, chunk_power(radix.base, level - 1));
+      self(self, q, level - 1);
+      q = ZERO;
+      self(self, r, level - 1);
+    };
+    for (size_t i = tails.size(); i > 0; --i) {
+      write_tail(write_tail, tails[i - 1].first, tails[i - 1].second);
+    }
+  }
+};
+
+char* big_integer::write_digits(char* out, const big_integer& x, int level, int base) {
+  const radix_info& radix = RADIXES[base];
+  if (x.size() < TO_STRING_THRESHOLD) {
+    uint32_t chunks[MAX_BASECASE_CHUNKS];
+    size_t count = radix_chunks(chunks, x.digits.data(), x.size(), radix.chunk);
+    out = std::fill_n(out, (radix.chunk_digits << level) - count * radix.chunk_digits, '0');
+    for (size_t i = count; i > 0; --i) {
+      write_chunk(out, chunks[i - 1], radix);
+      out += radix.chunk_digits;
+    }
+    return out;
+  }
+  big_integer q;
+  big_integer r;
+  divmod(q, r, x, chunk_power(base, level - 1));
+  out = write_digits(out, q, level - 1, base);
+  q = ZERO; // release the quotient before descending into the remainder
+  return write_digits(out, r, level - 1, base);
+}
+
+size_t big_integer::size_in_base(int base) const {
+  if (base < 2 || base > 36) {
+    throw std::invalid_argument("Base must be in range [2, 36]");
+  }
+  if (digits.empty()) {
+    return 1;
+  }
+  uint64_t bits = static_cast<uint64_t>(size()) * BASE_LOG2 - std::countl_zero(digits.back());
+  if (int log2 = RADIXES[base].log2; log2 != 0) {
+    return (bits + log2 - 1) / log2;
+  }
+  // |x| < 2^bits has at most floor(bits * log_base(2)) + 1 digits. The product with the rounded-up constant is
+  // split at 2^32 to stay within 64 bits.
+  uint64_t scale = DIGITS_PER_2_32_BITS[base];
+  return (bits >> 32) * scale + (((bits & UINT32_MAX) * scale) >> 32) + 1;
+}
+
+size_t big_integer::exact_digit_count() const {
+  // |x| >= 10^exponent? Decided by log10|x| from the leading two limbs unless it is within their rounding error
+  // of the exponent; only then the power of ten is built from the cached 10^(9 * 2^k).
+  auto at_least_power_of_ten = [this](size_t exponent) {
+    size_t n = size();
+    double leading = static_cast<double>(digits[n - 1]);
+    if (n > 1) {
+      leading = std::ldexp(leading, BASE_LOG2) + static_cast<double>(digits[n - 2]);
+    }
+    double estimate = std::log10(leading) + static_cast<double>((n < 2 ? 0 : n - 2) * BASE_LOG2) * 0.30102999566398120;
+    double margin = 1e-9 + 1e-12 * static_cast<double>(exponent);
+    if (estimate > static_cast<double>(exponent) + margin) {
+      return true;
+    } else if (estimate < static_cast<double>(exponent) - margin) {
+      return false;
+    }
+    return !power_of_ten(exponent).abs_greater(*this);
+  };
+  // The estimate exceeds the exact count by at most two.
+  size_t count = size_in_base(10);
+  while (count > 1 && !at_least_power_of_ten(count - 1)) {
+    --count;
+  }
+  return count;
+}
+
+big_integer big_integer::power_of_ten(size_t exponent) {
+  big_integer power(TEN_POWERS[exponent % DECIMAL_CHUNK_DIGITS]);
+  for (size_t k = 0, chunks = exponent / DECIMAL_CHUNK_DIGITS; chunks != 0; ++k, chunks >>= 1) {
+    if (chunks & 1) {
+      power *= chunk_power(10, k);
+    }
+  }
+  return power;
+}
+
+big_integer big_integer::scale_down_decimal(size_t exponent, bool nearest) const {
+  constexpr uint64_t GUARD_BITS = 64;
+  constexpr uint64_t TOLERANCE = uint64_t(1) << 32;
+  size_t n = size();
+  uint64_t bits = static_cast<uint64_t>(n) * BASE_LOG2 - std::countl_zero(digits.back());
+  auto bit_length = [](const big_integer& a) {
+    return static_cast<uint64_t>(a.size()) * BASE_LOG2 - std::countl_zero(a.digits.back());
+  };
+  // Upper bound for the bit length of the result, plus enough bits for everything below to be exact to 2^-96
+  // of it.
+  uint64_t removed_bits = static_cast<uint64_t>(static_cast<double>(exponent) * 3.3219280948873622);
+  uint64_t result_bits = bits - std::min(bits, removed_bits) + 2;
+  size_t used = (result_bits + 96) / BASE_LOG2 + 2;
+  if (used < n) {
+    // |x| / 10^e = (T + t) * 2^(32s) / (5^e * 2^e), where T are the top limbs, s the dropped ones and 0 <= t < 1.
+    // 5^e is approximated from below by a * 2^shift: truncating to `precision` bits after every step of the
+    // powering, which at most doubles the accumulated relative error per step.
+    uint64_t precision = result_bits + 96 + std::bit_width(exponent) + 2;
+    big_integer a(1);
+    uint64_t shift = 0;
+    for (int bit = std::bit_width(exponent) - 1; bit >= 0; --bit) {
+      a *= a;
+      shift *= 2;
+      if ((exponent >> bit) & 1) {
+        a *= 5;
+      }
+      if (uint64_t length = bit_length(a); length > precision) {
+        fdiv_q_2exp(a, a, length - precision);
+        shift += length - precision;
+      }
+    }
+    big_integer scaled(limbs(digits.end() - used, digits.end()));
+    // scaled = floor(T * 2^(32s + GUARD_BITS) / (a * 2^(shift + e))): |x| / 10^e in fixed point, off by far less
+    // than TOLERANCE units in the last place.
+    int64_t z = static_cast<int64_t>((n - used) * BASE_LOG2 + GUARD_BITS) - static_cast<int64_t>(shift + exponent);
+    if (z >= 0) {
+      mul_2exp(scaled, scaled, z);
+    } else {
+      mul_2exp(a, a, -z);
+    }
+    scaled /= a;
+    big_integer low;
+    mod_2exp(low, scaled, GUARD_BITS);
+    uint64_t fraction = 0;
+    for (size_t i = 0; i < low.size(); ++i) {
+      fraction |= static_cast<uint64_t>(low.digits[i]) << (i * BASE_LOG2);
+    }
+    fdiv_q_2exp(scaled, scaled, GUARD_BITS);
+    constexpr uint64_t HALF = uint64_t(1) << (GUARD_BITS - 1);
+    if (nearest && (fraction < HALF - TOLERANCE || fraction > HALF + TOLERANCE)) {
+      if (fraction > HALF) {
+        ++scaled;
+      }
+      return scaled;
+    }
+    if (!nearest && fraction > TOLERANCE && fraction < ~uint64_t(0) - TOLERANCE) {
+      return scaled;
+    }
+  }
+  big_integer power = power_of_ten(exponent);
+  big_integer q;
+  big_integer r;
+  divmod(q, r, *this, power);
+  q.set_negative(false);
+  r.set_negative(false);
+  if (nearest) {
+    mul_2exp(r, r, 1);
+    if (r > power || (r == power && (q.first_digit() & 1))) {
+      ++q;
+    }
+  }
+  return q;
+}
+
+std::string big_integer::leading_digits(size_t k) const {
+  if (k == 0) {
+    return {};
+  }
+  size_t count = exact_digit_count();
+  if (count <= k) {
+    std::string all = to_string(*this);
+    return negative() ? all.substr(1) : all;
+  }
+  return to_string(scale_down_decimal(count - k, false));
+}
+
+std::string big_integer::to_scientific(size_t precision) const {
+  std::string mantissa;
+  size_t exponent = 0;
+  if (!digits.empty()) {
+    size_t count = exact_digit_count();
+    exponent = count - 1;
+    if (count <= precision + 1) {
+      mantissa = to_string(*this).substr(negative() ? 1 : 0);
+    } else {
+      mantissa = to_string(scale_down_decimal(count - precision - 1, true));
+      // Rounded up to 10^(precision + 1).
+      if (mantissa.size() > precision + 1) {
+        mantissa.pop_back();
+        ++exponent;
+      }
+    }
+  }
+  mantissa.resize(precision + 1, '0');
+  std::string result = negative() ? "-" : "";
+  result += mantissa[0];
+  if (precision != 0) {
+    result += '.';
+    result.append(mantissa, 1);
+  }
+  result += 'e';
+  result += std::to_string(exponent);
+  return result;
+}
+
+char* big_integer::write_digits_parallel(char* out, const big_integer& x, int level, int base, unsigned threads) {
+  if (threads <= 1 || x.size() < PARALLEL_THRESHOLD) {
+    return write_digits(out, x, level, base);
+  }
+  // Both halves go to disjoint ranges of the output: the high one is written on a new thread.
+  big_integer q;
+  big_integer r;
+  divmod(q, r, x, chunk_power(base, level - 1));
+  size_t half = RADIXES[base].chunk_digits << (level - 1);
+  std::future<char*> high =
+      std::async(std::launch::async, write_digits_parallel, out, std::cref(q), level - 1, base, threads / 2);
+  write_digits_parallel(out + half, r, level - 1, base, threads - threads / 2);
+  high.get();
+  return out + 2 * half;
+}
+
+std::to_chars_result to_chars(char* first, char* last, const big_integer& value, int base) {
+  if (base < 2 || base > 36) {
+    return {first, std::errc::invalid_argument};
+  }
+  if (value.digits.empty()) {
+    if (first == last) {
+      return {last, std::errc::value_too_large};
+    }
+    *first = '0';
+    return {first + 1, std::errc()};
+  }
+  big_integer::radix_layout layout(value, base);
+  if (static_cast<size_t>(last - first) < layout.length + value.negative()) {
+    return {last, std::errc::value_too_large};
+  }
+  if (value.negative()) {
+    *first++ = '-';
+  }
+  return {layout.write(first), std::errc()};
+}
+
+std::from_chars_result from_chars(const char* first, const char* last, big_integer& value, int base) {
+  return from_chars(first, last, value, base, 1);
+}
+
+std::from_chars_result from_chars(const char* first, const char* last, big_integer& value, int base,
+                                  unsigned threads) {
+  if (base < 2 || base > 36) {
+    return {first, std::errc::invalid_argument};
+  }
+  const char* digits = first;
+  bool negative = false;
+  if (digits != last && *digits == '-') {
+    negative = true;
+    ++digits;
+  }
+  size_t length = find_non_digit(digits, last - digits, base);
+  if (length == 0) {
+    return {first, std::errc::invalid_argument};
+  }
+  const char* end = digits + length;
+  while (digits != end && *digits == '0') {
+    ++digits;
+  }
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  big_integer result = big_integer::read_digits_parallel(digits, end - digits, base, threads);
+  result.set_negative(negative && !result.digits.empty());
+  value = std::move(result);
+  return {end, std::errc()};
+}
+
+std::string to_string(const big_integer& a, int base) {
+  return to_string(a, base, 1);
+}
+
+std::string to_string(const big_integer& a, int base, unsigned threads) {
+  if (base < 2 || base > 36) {
+    throw std::invalid_argument("Base must be in range [2, 36]");
+  }
+  if (a.digits.empty()) {
+    return "0";
   }
-  std::reverse(digits.begin(), digits.end());
-  for (size_t i = 0; i < digits.size(); ++i) {
-    result += digits[i];
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
   }
+  big_integer::radix_layout layout(a, base);
+  std::string result(layout.length + a.negative(), '-');
+  layout.write(result.data() + a.negative(), threads);
   return result;
 }
 
 std::ostream& operator<<(std::ostream& out, const big_integer& a) {
-  return out << to_string(a);
+  std::ostream::sentry sentry(out);
+  if (!sentry) {
+    return out;
+  }
+  std::ios_base::fmtflags flags = out.flags();
+  std::ios_base::fmtflags basefield = flags & std::ios_base::basefield;
+  int base = (basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10);
+  bool uppercase = (flags & std::ios_base::uppercase) != 0;
+
+  char prefix[3];
+  size_t prefix_length = 0;
+  if (a.negative()) {
+    prefix[prefix_length++] = '-';
+  } else if ((flags & std::ios_base::showpos) && base == 10) {
+    prefix[prefix_length++] = '+';
+  }
+  // Internal padding goes after the sign and 0x, but before the leading 0 of octal (as for built-in integers).
+  size_t pad_position = prefix_length;
+  if ((flags & std::ios_base::showbase) && base != 10 && !a.digits.empty()) {
+    prefix[prefix_length++] = '0';
+    if (base == 16) {
+      prefix[prefix_length++] = (uppercase ? 'X' : 'x');
+      pad_position = prefix_length;
+    }
+  }
+
+  std::optional<big_integer::radix_layout> layout;
+  size_t length = 1;
+  if (!a.digits.empty()) {
+    length = layout.emplace(a, base).length;
+  }
+  std::streamsize width = out.width(0);
+  size_t padding = (width > 0 && static_cast<size_t>(width) > prefix_length + length
+                        ? static_cast<size_t>(width) - prefix_length - length
+                        : 0);
+  auto pad = [&] {
+    for (size_t i = 0; i < padding; ++i) {
+      out.put(out.fill());
+    }
+  };
+
+  std::ios_base::fmtflags adjust = flags & std::ios_base::adjustfield;
+  if (adjust != std::ios_base::left && adjust != std::ios_base::internal) {
+    pad();
+  }
+  if (adjust == std::ios_base::internal) {
+    out.write(prefix, pad_position);
+    pad();
+    out.write(prefix + pad_position, prefix_length - pad_position);
+  } else {
+    out.write(prefix, prefix_length);
+  }
+  if (layout) {
+    layout->write(out, uppercase);
+  } else {
+    out.put('0');
+  }
+  if (adjust == std::ios_base::left) {
+    pad();
+  }
+  return out;
+}
+
+std::istream& operator>>(std::istream& in, big_integer& a) {
+  std::istream::sentry sentry(in);
+  if (!sentry) {
+    return in;
+  }
+  using traits = std::istream::traits_type;
+  std::streambuf* buf = in.rdbuf();
+  traits::int_type c = buf->sgetc();
+  auto next = [&] { c = buf->snextc(); };
+
+  bool negative = false;
+  if (c == '-' || c == '+') {
+    negative = (c == '-');
+    next();
+  }
+  // As for built-in integers: hex accepts an optional 0x prefix, an empty basefield detects 0x / 0 / decimal.
+  std::ios_base::fmtflags basefield = in.flags() & std::ios_base::basefield;
+  int base = (basefield == std::ios_base::hex   ? 16
+              : basefield == std::ios_base::oct ? 8
+              : basefield == std::ios_base::dec ? 10
+                                                : 0);
+  bool any_digits = false;
+  if ((base == 16 || base == 0) && c == '0') {
+    any_digits = true;
+    next();
+    if (c == 'x' || c == 'X') {
+      any_digits = false;
+      base = 16;
+      next();
+    } else if (base == 0) {
+      base = 8;
+    }
+  }
+  if (base == 0) {
+    base = 10;
+  }
+
+  // Digits are parsed in blocks of d * 2^STREAM_BLOCK_LEVEL as they arrive. Full blocks are merged like a
+  // binary counter, so that every multiplication is between operands of similar size.
+  const radix_info& radix = RADIXES[base];
+  auto scale = [&](big_integer& x, size_t count) { // x *= base^count
+    if (radix.log2 != 0) {
+      mul_2exp(x, x, static_cast<uint64_t>(count) * radix.log2);
+      return;
+    }
+    for (size_t k = 0, chunks = count / radix.chunk_digits; chunks != 0; ++k, chunks >>= 1) {
+      if (chunks & 1) {
+        x *= big_integer::chunk_power(base, k);
+      }
+    }
+    uint32_t rest = 1;
+    for (size_t i = 0; i < count % radix.chunk_digits; ++i) {
+      rest *= radix.base;
+    }
+    if (rest != 1) {
+      x *= big_integer(rest);
+    }
+  };
+  std::vector<std::pair<big_integer, int>> blocks;
+  std::string block(radix.chunk_digits << STREAM_BLOCK_LEVEL, '\0');
+  size_t length = 0;
+  for (; !traits::eq_int_type(c, traits::eof()) && DIGIT_VALUES[static_cast<unsigned char>(c)] < radix.base; next()) {
+    any_digits = true;
+    block[length++] = traits::to_char_type(c);
+    if (length == block.size()) {
+      big_integer value = big_integer::read_digits(block.data(), length, base);
+      int level = STREAM_BLOCK_LEVEL;
+      for (; !blocks.empty() && blocks.back().second == level; ++level) {
+        scale(blocks.back().first, radix.chunk_digits << level);
+        value += blocks.back().first;
+        blocks.pop_back();
+      }
+      blocks.emplace_back(std::move(value), level);
+      length = 0;
+    }
+  }
+
+  std::ios_base::iostate state = std::ios_base::goodbit;
+  if (traits::eq_int_type(c, traits::eof())) {
+    state |= std::ios_base::eofbit;
+  }
+  if (!any_digits) {
+    // As for built-in integers, a failed extraction stores zero.
+    a = 0;
+    state |= std::ios_base::failbit;
+  } else {
+    big_integer result(std::allocator_arg, a.get_allocator());
+    for (auto& [value, level] : blocks) {
+      scale(result, radix.chunk_digits << level);
+      result += value;
+    }
+    scale(result, length);
+    result += big_integer::read_digits(block.data(), length, base);
+    result.set_negative(negative && !result.digits.empty());
+    a = std::move(result);
+  }
+  in.setstate(state);
+  return in;
 }
\ No newline at end of file
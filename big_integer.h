@@ -1,14 +1,53 @@
 #pragma once
 
+#include "limb_vector.h"
+
+#include <charconv>
 #include <concepts>
 #include <cstdint>
 #include <iosfwd>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
+// 1 to take limb storage from std::pmr memory resources (see big_integer::allocator_type), 0 for std::allocator.
+#ifndef BIG_INTEGER_PMR
+#define BIG_INTEGER_PMR 0
+#endif
+
+#if BIG_INTEGER_PMR
+#include <memory_resource>
+#endif
+
+// 1 for 64-bit limbs with unsigned __int128 intermediates (GCC / Clang on 64-bit targets), 0 for 32-bit limbs.
+#ifndef BIG_INTEGER_64BIT_LIMBS
+#define BIG_INTEGER_64BIT_LIMBS 0
+#endif
+
+// 1 to pack a big_integer into 16 bytes (a pointer, a 32-bit size that also holds the sign and a 32-bit capacity),
+// which limits values to 2^31 - 1 limbs; 0 for pointer-sized size and capacity.
+#ifndef BIG_INTEGER_COMPACT_LAYOUT
+#define BIG_INTEGER_COMPACT_LAYOUT 0
+#endif
+
+// Number of limbs a big_integer stores without allocating. The compact layout keeps them in place of the pointer.
+#ifndef BIG_INTEGER_INLINE_LIMBS
+#if BIG_INTEGER_COMPACT_LAYOUT && BIG_INTEGER_64BIT_LIMBS
+#define BIG_INTEGER_INLINE_LIMBS 1
+#else
+#define BIG_INTEGER_INLINE_LIMBS 2
+#endif
+#endif
+
+// Copies of values with at least this many limbs share their buffer until one of them is modified, 0 to always copy.
+#ifndef BIG_INTEGER_SHARE_THRESHOLD
+#define BIG_INTEGER_SHARE_THRESHOLD 0
+#endif
+
 struct big_integer {
 private:
   using size_t = std::size_t;
@@ -18,48 +57,123 @@ private:
   using uint32_t = std::uint32_t;
   using uint8_t = std::uint8_t;
 
+public:
+  // Magnitudes are stored as little-endian limbs; products and carries are computed in double_limb.
+  // The limb width does not change any observable behavior.
+#if BIG_INTEGER_64BIT_LIMBS
+  using limb = std::uint64_t;
+  __extension__ typedef unsigned __int128 double_limb;
+#else
+  using limb = std::uint32_t;
+  using double_limb = std::uint64_t;
+#endif
+
+  // Allocator of the limbs. With BIG_INTEGER_PMR every value remembers the memory resource it was built with, as
+  // std::pmr containers do: copies made by the copy constructor take the default resource, moves take the resource
+  // of the source, assignment and swap never change it, and the result of an operator (and of ++ / --, unary
+  // minus, ~) uses the resource of its big_integer operand, the left one if there are two. Values can be
+  // allocated from a specific resource with the std::allocator_arg constructors, which std::pmr containers of
+  // big_integer call on their own.
+#if BIG_INTEGER_PMR
+  using allocator_type = std::pmr::polymorphic_allocator<limb>;
+#else
+  using allocator_type = std::allocator<limb>;
+#endif
+
 private:
-  static const std::vector<uint32_t> TEN_POWERS;
-  static const big_integer TEN;
   static const big_integer ZERO;
-  static constexpr uint32_t MASK = ((1ll << 32) - 1);
-  static constexpr uint8_t BASE_LOG2 = 32;
-  static constexpr uint64_t BASE = (1ll << 32);
+  static constexpr limb MASK = std::numeric_limits<limb>::max();
+  static constexpr uint8_t BASE_LOG2 = std::numeric_limits<limb>::digits;
 
 private:
-  std::vector<uint32_t> digits;
-  bool is_negative;
+  // The sign is kept as the flag of the limbs.
+  using limbs = limb_vector<limb, BIG_INTEGER_INLINE_LIMBS, allocator_type, BIG_INTEGER_SHARE_THRESHOLD,
+                            BIG_INTEGER_COMPACT_LAYOUT != 0>;
 
-  explicit big_integer(std::vector<uint32_t>& digits, bool is_negative = false);
+  limbs digits;
+
+  explicit big_integer(limbs digits, bool is_negative = false);
+
+  bool negative() const noexcept {
+    return digits.flag();
+  }
+  void set_negative(bool value) noexcept {
+    digits.set_flag(value);
+  }
 
 private:
-  static bool is_correct_digit(char ch) noexcept;
-  static void remove_leading_zeros(std::vector<uint32_t>& v) noexcept;
+  static void remove_leading_zeros(limbs& v) noexcept;
 
-  bool abs_greater(const big_integer& rhs) noexcept;
+  bool abs_greater(const big_integer& rhs) const noexcept;
+  // |*this| + |rhs| and |*this| - |rhs| in place, keeping the sign of *this (flipped if the difference is negative).
+  void add_abs(const big_integer& rhs);
+  void sub_abs(const big_integer& rhs);
   void negate() noexcept;
-  void apply_additional_code();
-  void add_to_ith(size_t pos, uint32_t x);
-  uint32_t first_digit() const noexcept;
-  void swap(big_integer& other) noexcept;
+  void add_to_ith(size_t pos, limb x);
+  // *this += a * b, or -= with subtract.
+  void add_product(const big_integer& a, const big_integer& b, bool subtract);
+  limb first_digit() const noexcept;
+  void swap(big_integer& other) noexcept(std::is_nothrow_swappable_v<limbs>);
+  // Whether rhs can lend its buffer to the result of an operator on lhs and rhs (it has the allocator of lhs), and
+  // whether it should when lhs could as well (its buffer is also larger).
+  static bool lends_buffer(const big_integer& lhs, const big_integer& rhs) noexcept;
+  static bool lends_larger_buffer(const big_integer& lhs, const big_integer& rhs) noexcept;
 
   static bool or_negate_predicate(bool is_negative_lhs, bool is_negative_rhs);
   static bool and_negate_predicate(bool is_negative_lhs, bool is_negative_rhs);
   static bool xor_negate_predicate(bool is_negative_lhs, bool is_negative_rhs);
-  static uint64_t or_operation(uint64_t lhs, uint64_t rhs);
-  static uint64_t and_operation(uint64_t lhs, uint64_t rhs);
-  static uint64_t xor_operation(uint64_t lhs, uint64_t rhs);
-  void do_bitwise_operation(const big_integer& rhs, uint64_t (*operation)(uint64_t, uint64_t),
+  static limb or_operation(limb lhs, limb rhs);
+  static limb and_operation(limb lhs, limb rhs);
+  static limb xor_operation(limb lhs, limb rhs);
+  void do_bitwise_operation(const big_integer& rhs, limb (*operation)(limb, limb),
                             bool (*negate_predicate)(bool negative1, bool negative2));
 
-  friend std::pair<big_integer, big_integer> div_mod(const big_integer& lhs, const big_integer& rhs);
-  friend std::pair<big_integer, big_integer> div_mod(const big_integer& lhs, uint32_t rhs);
+public:
+  // Rounding of the quotient for divmod / div_q / div_r:
+  // trunc - towards zero (as operator/ and operator%), floor - towards -inf,
+  // ceil - towards +inf, euclid - remainder is always non-negative.
+  enum class rounding { trunc, floor, ceil, euclid };
+
+private:
+  static void divmod_impl(big_integer* q, big_integer* r, const big_integer& a, const big_integer& b, rounding mode);
+  static void shift_right_impl(big_integer& q, const big_integer& a, uint64_t bits, bool round_down);
+
+  // Divide-and-conquer radix conversions use P[k] = chunk^(2^k), where chunk = base^d is the largest power
+  // of the base that fits in 32 bits. chunk_power() returns P[k] from the process-wide cache, building it if needed.
+  static const big_integer& chunk_power(int base, size_t k);
+  // Parses [first, first + length), which must contain only digits of the base.
+  static big_integer read_digits(const char* first, size_t length, int base);
+  // The same, with the two halves of long strings read concurrently by up to `threads` threads.
+  static big_integer read_digits_parallel(const char* first, size_t length, int base, unsigned threads);
+  // Writes |x| < base^(d * 2^level) as exactly d * 2^level digits, returns the end of the written digits.
+  static char* write_digits(char* out, const big_integer& x, int level, int base);
+  // The same, with the two halves of large numbers converted concurrently by up to `threads` threads.
+  static char* write_digits_parallel(char* out, const big_integer& x, int level, int base, unsigned threads);
+  // 10^exponent, assembled from the cached powers.
+  static big_integer power_of_ten(size_t exponent);
+  // |*this| / 10^exponent, truncated or rounded to nearest (ties to even).
+  big_integer scale_down_decimal(size_t exponent, bool nearest) const;
+  struct radix_layout;
 
   size_t size() const noexcept;
 
 public:
   big_integer();
   big_integer(const big_integer& other) = default;
+  // Moves take the limb buffer and leave the source equal to zero.
+  big_integer(big_integer&& other) noexcept;
+
+  big_integer(std::allocator_arg_t, const allocator_type& alloc) noexcept;
+  big_integer(std::allocator_arg_t, const allocator_type& alloc, const big_integer& other);
+  big_integer(std::allocator_arg_t, const allocator_type& alloc, big_integer&& other);
+  // Any other constructor, with the value built first and then moved into storage from alloc.
+  template <typename... Args>
+    requires(std::constructible_from<big_integer, Args...> &&
+             !(std::same_as<std::remove_cvref_t<Args>, big_integer> || ...))
+  big_integer(std::allocator_arg_t, const allocator_type& alloc, Args&&... args)
+      : big_integer(std::allocator_arg, alloc, big_integer(std::forward<Args>(args)...)) {}
+
+  allocator_type get_allocator() const noexcept;
 
   big_integer(unsigned long long x);
 
@@ -75,10 +189,23 @@ public:
 
   static uint64_t my_abs(int64_t a);
 
-  explicit big_integer(const std::string& str);
+  // Conversions to and from strings share a process-wide cache of the powers of every base they divide or
+  // multiply by. It grows on demand and is safe to use from many threads; once a power is built, reading it
+  // takes no lock. prewarm_power_cache() builds everything needed for numbers of up to `digits` digits in
+  // advance. clear_power_cache() frees the cache and must not run concurrently with any conversion.
+  static void prewarm_power_cache(size_t digits, int base = 10);
+  static void clear_power_cache();
+
+  // Optional '-' followed by digits of the base (2..36, letters of either case stand for 10..35).
+  explicit big_integer(std::string_view str, int base = 10);
+  // Parallel parsing for strings of millions of digits, see from_chars().
+  explicit big_integer(std::string_view str, int base, unsigned threads);
   ~big_integer();
 
   big_integer& operator=(const big_integer& other);
+  // Assignments keep the allocator of *this; the move only copies limbs if the allocators differ.
+  big_integer& operator=(big_integer&& other) noexcept(std::is_nothrow_move_assignable_v<limbs>);
+  friend void swap(big_integer& a, big_integer& b) noexcept(std::is_nothrow_swappable_v<limbs>);
 
   big_integer& operator+=(const big_integer& rhs);
   big_integer& operator+=(int64_t rhs);
@@ -106,6 +233,19 @@ public:
   big_integer& operator--();
   big_integer operator--(int);
 
+  // Number of digits of |*this| in the base (2..36), sign not included. Exact for powers of two, otherwise an
+  // O(1) upper bound from the bit length that may exceed the exact count by one, rarely two.
+  size_t size_in_base(int base) const;
+  // Exact number of decimal digits of |*this|. Usually O(1) from the leading limbs; a power of ten is only
+  // built and compared when |*this| is within rounding error of one.
+  size_t exact_digit_count() const;
+  // The first k decimal digits of |*this| (all of them if there are fewer), and "[-]d.ddde<exponent>" with
+  // `precision` digits after the point, rounded to nearest with ties to even. Both work from the leading limbs in
+  // time that depends on k / precision rather than on the size of the number, falling back to an exact division
+  // only when the result is too close to a rounding boundary to decide.
+  std::string leading_digits(size_t k) const;
+  std::string to_scientific(size_t precision) const;
+
   friend bool operator==(const big_integer& a, const big_integer& b);
   friend bool operator!=(const big_integer& a, const big_integer& b);
   friend bool operator<(const big_integer& a, const big_integer& b);
@@ -132,7 +272,100 @@ public:
   friend big_integer operator<<(const big_integer& a, int b);
   friend big_integer operator>>(const big_integer& a, int b);
 
+  // The overloads that take rvalues build the result in the buffer of one of them instead of a copy. It still gets
+  // the allocator of the left big_integer operand: a right operand only lends its buffer if its allocator is equal.
+  // Of two rvalues, the one with the larger buffer is reused.
+  friend big_integer operator+(big_integer&& a, const big_integer& b);
+  friend big_integer operator+(const big_integer& a, big_integer&& b);
+  friend big_integer operator+(big_integer&& a, big_integer&& b);
+  friend big_integer operator-(big_integer&& a, const big_integer& b);
+  friend big_integer operator-(const big_integer& a, big_integer&& b);
+  friend big_integer operator-(big_integer&& a, big_integer&& b);
+  friend big_integer operator*(big_integer&& a, const big_integer& b);
+  friend big_integer operator*(const big_integer& a, big_integer&& b);
+  friend big_integer operator*(big_integer&& a, big_integer&& b);
+  friend big_integer operator+(big_integer&& a, int64_t b);
+  friend big_integer operator-(big_integer&& a, int64_t b);
+  friend big_integer operator*(big_integer&& a, int64_t b);
+  friend big_integer operator+(int64_t a, big_integer&& b);
+  friend big_integer operator-(int64_t a, big_integer&& b);
+  friend big_integer operator*(int64_t a, big_integer&& b);
+  friend big_integer operator/(big_integer&& a, const big_integer& b);
+  friend big_integer operator/(const big_integer& a, big_integer&& b);
+  friend big_integer operator/(big_integer&& a, big_integer&& b);
+  friend big_integer operator%(big_integer&& a, const big_integer& b);
+  friend big_integer operator%(const big_integer& a, big_integer&& b);
+  friend big_integer operator%(big_integer&& a, big_integer&& b);
+
+  friend big_integer operator&(big_integer&& a, const big_integer& b);
+  friend big_integer operator&(const big_integer& a, big_integer&& b);
+  friend big_integer operator&(big_integer&& a, big_integer&& b);
+  friend big_integer operator|(big_integer&& a, const big_integer& b);
+  friend big_integer operator|(const big_integer& a, big_integer&& b);
+  friend big_integer operator|(big_integer&& a, big_integer&& b);
+  friend big_integer operator^(big_integer&& a, const big_integer& b);
+  friend big_integer operator^(const big_integer& a, big_integer&& b);
+  friend big_integer operator^(big_integer&& a, big_integer&& b);
+
+  friend big_integer operator<<(big_integer&& a, int b);
+  friend big_integer operator>>(big_integer&& a, int b);
+
+  friend void divmod(big_integer& q, big_integer& r, const big_integer& a, const big_integer& b, rounding mode);
+  friend void div_q(big_integer& q, const big_integer& a, const big_integer& b, rounding mode);
+  friend void div_r(big_integer& r, const big_integer& a, const big_integer& b, rounding mode);
+
+  // Shifts by a 64-bit bit count: r = a * 2^bits, q = a / 2^bits rounded towards -inf (fdiv, same as operator>>)
+  // or towards zero (tdiv), r = a mod 2^bits (always non-negative). Outputs may alias a.
+  friend void mul_2exp(big_integer& r, const big_integer& a, uint64_t bits);
+  friend void fdiv_q_2exp(big_integer& q, const big_integer& a, uint64_t bits);
+  friend void tdiv_q_2exp(big_integer& q, const big_integer& a, uint64_t bits);
+  friend void mod_2exp(big_integer& r, const big_integer& a, uint64_t bits);
+
+  // r += a * b and r -= a * b without a temporary for the product: a single-limb factor is multiplied into r limb by
+  // limb, larger products are formed in scratch space and added from there. r may alias a or b.
+  friend void addmul(big_integer& r, const big_integer& a, const big_integer& b);
+  friend void submul(big_integer& r, const big_integer& a, const big_integer& b);
+
+  // Honor the base (dec / hex / oct), showbase, showpos, uppercase, width, fill and adjustfield flags.
+  // Output is produced in blocks, reading parses digits in blocks as they arrive; neither builds the full string.
   friend std::ostream& operator<<(std::ostream& out, const big_integer& a);
+  friend std::istream& operator>>(std::istream& in, big_integer& a);
+
+  friend std::to_chars_result to_chars(char* first, char* last, const big_integer& value, int base);
+  friend std::from_chars_result from_chars(const char* first, const char* last, big_integer& value, int base);
+  friend std::from_chars_result from_chars(const char* first, const char* last, big_integer& value, int base,
+                                           unsigned threads);
 
-  friend std::string to_string(const big_integer& a);
+  friend std::string to_string(const big_integer& a, int base);
+  friend std::string to_string(const big_integer& a, int base, unsigned threads);
 };
+
+// q = a / b, r = a - q * b, quotient rounded according to mode. q and r must be distinct objects,
+// but may alias a or b; their existing buffers are reused.
+void divmod(big_integer& q, big_integer& r, const big_integer& a, const big_integer& b,
+            big_integer::rounding mode = big_integer::rounding::trunc);
+// Quotient only: the remainder is never materialized.
+void div_q(big_integer& q, const big_integer& a, const big_integer& b,
+           big_integer::rounding mode = big_integer::rounding::trunc);
+// Remainder only: the quotient limbs are never stored.
+void div_r(big_integer& r, const big_integer& a, const big_integer& b,
+           big_integer::rounding mode = big_integer::rounding::trunc);
+
+// <charconv>-style conversions: no exceptions on bad input, nothing is allocated for the output.
+// to_chars writes [-]digits without a terminator, or returns {last, errc::value_too_large} if they do not fit.
+// from_chars accepts an optional '-' followed by digits and stops at the first non-digit; if there are no digits
+// it returns {first, errc::invalid_argument} and leaves value unchanged. Bases 2..36 are supported, others
+// report errc::invalid_argument. Digits above 9 are written as lowercase letters and read in either case.
+// Power-of-two bases take linear time, the others go through divide-and-conquer on powers of the base.
+std::to_chars_result to_chars(char* first, char* last, const big_integer& value, int base = 10);
+std::from_chars_result from_chars(const char* first, const char* last, big_integer& value, int base = 10);
+// Opt-in parallel parsing: independent digit ranges are converted by up to `threads` threads (0 for all
+// hardware threads) and combined bottom-up with the cached powers of the base.
+std::from_chars_result from_chars(const char* first, const char* last, big_integer& value, int base,
+                                  unsigned threads);
+
+// Throws std::invalid_argument if base is not in 2..36.
+std::string to_string(const big_integer& a, int base = 10);
+// Opt-in parallel conversion for numbers of millions of digits: independent subtrees of the conversion are
+// written by up to `threads` threads (0 for all hardware threads) into disjoint ranges of the result.
+std::string to_string(const big_integer& a, int base, unsigned threads);
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "big_integer.h"
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+
+// Opt-in expression templates. +, - and * with a lazy(x) operand build an expression tree instead of computing each
+// intermediate value; the tree is evaluated when it is converted to big_integer, by assign(), or by += / -= into a
+// big_integer. Evaluation accumulates the terms of a sum straight into the destination, products of two operands
+// with addmul / submul, so `big_integer r = lazy(a) * b + lazy(c) * d - e` forms no full-size temporaries. Other
+// shapes (a product with a sum or another product as a factor) evaluate that factor on its own first. The result
+// takes the allocator of the leftmost big_integer in the expression.
+//
+// The tree refers to big_integer lvalues and has to be evaluated while they are alive; rvalues and integers are
+// stored in it. The destination may appear in the expression.
+namespace big_integer_expr {
+
+template <typename Derived>
+struct node;
+
+template <typename E>
+concept expression = std::is_base_of_v<node<E>, E>;
+
+template <expression E>
+big_integer evaluate(const E& e);
+
+template <typename Derived>
+struct node {
+  operator big_integer() const {
+    return evaluate(static_cast<const Derived&>(*this));
+  }
+};
+
+// A big_integer lvalue.
+class ref : public node<ref> {
+public:
+  explicit ref(const big_integer& x) noexcept : target(&x) {}
+
+  const big_integer& get() const noexcept {
+    return *target;
+  }
+
+private:
+  const big_integer* target;
+};
+
+// A big_integer owned by the expression.
+class value : public node<value> {
+public:
+  explicit value(big_integer x) noexcept : x(std::move(x)) {}
+
+  const big_integer& get() const noexcept {
+    return x;
+  }
+
+private:
+  big_integer x;
+};
+
+template <typename L, typename R>
+struct sum : node<sum<L, R>> {
+  sum(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+  L lhs;
+  R rhs;
+};
+
+template <typename L, typename R>
+struct difference : node<difference<L, R>> {
+  difference(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+  L lhs;
+  R rhs;
+};
+
+template <typename L, typename R>
+struct product : node<product<L, R>> {
+  product(L lhs, R rhs) : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+
+  L lhs;
+  R rhs;
+};
+
+template <typename E>
+struct negation : node<negation<E>> {
+  explicit negation(E operand) : operand(std::move(operand)) {}
+
+  E operand;
+};
+
+inline ref lazy(const big_integer& x) noexcept {
+  return ref(x);
+}
+
+inline value lazy(big_integer&& x) noexcept {
+  return value(std::move(x));
+}
+
+namespace detail {
+
+template <typename E>
+constexpr bool is_leaf = std::is_same_v<E, ref> || std::is_same_v<E, value>;
+
+template <typename T>
+concept operand = expression<std::remove_cvref_t<T>> || std::same_as<std::remove_cvref_t<T>, big_integer> ||
+                  std::integral<std::remove_cvref_t<T>>;
+
+template <typename L, typename R>
+concept operands = operand<L> && operand<R> &&
+                   (expression<std::remove_cvref_t<L>> || expression<std::remove_cvref_t<R>>);
+
+template <typename T>
+auto to_node(T&& x) {
+  using type = std::remove_cvref_t<T>;
+  if constexpr (expression<type>) {
+    return type(std::forward<T>(x));
+  } else if constexpr (std::integral<type>) {
+    return value(big_integer(x));
+  } else if constexpr (std::is_lvalue_reference_v<T>) {
+    return ref(x);
+  } else {
+    return value(std::move(x));
+  }
+}
+
+template <typename T>
+using node_t = decltype(to_node(std::declval<T>()));
+
+// Whether evaluating e reads x.
+template <typename E>
+bool refers_to(const E& e, const big_integer& x) noexcept {
+  if constexpr (std::is_same_v<E, ref>) {
+    return &e.get() == &x;
+  } else if constexpr (std::is_same_v<E, value>) {
+    return false;
+  } else if constexpr (requires { e.operand; }) {
+    return refers_to(e.operand, x);
+  } else {
+    return refers_to(e.lhs, x) || refers_to(e.rhs, x);
+  }
+}
+
+template <typename E>
+big_integer::allocator_type allocator_of(const E& e) noexcept {
+  if constexpr (is_leaf<E>) {
+    return e.get().get_allocator();
+  } else if constexpr (requires { e.operand; }) {
+    return allocator_of(e.operand);
+  } else {
+    return allocator_of(e.lhs);
+  }
+}
+
+// A leaf as it is, anything else evaluated into a temporary.
+template <typename E>
+decltype(auto) factor(const E& e) {
+  if constexpr (is_leaf<E>) {
+    return e.get();
+  } else {
+    return evaluate(e);
+  }
+}
+
+// r += e, or r -= e with subtract; e must not refer to r.
+template <typename E>
+void accumulate(big_integer& r, const E& e, bool subtract) {
+  if constexpr (is_leaf<E>) {
+    if (subtract) {
+      r -= e.get();
+    } else {
+      r += e.get();
+    }
+  } else if constexpr (requires { e.operand; }) {
+    accumulate(r, e.operand, !subtract);
+  } else if constexpr (std::is_same_v<E, sum<decltype(e.lhs), decltype(e.rhs)>>) {
+    accumulate(r, e.lhs, subtract);
+    accumulate(r, e.rhs, subtract);
+  } else if constexpr (std::is_same_v<E, difference<decltype(e.lhs), decltype(e.rhs)>>) {
+    accumulate(r, e.lhs, subtract);
+    accumulate(r, e.rhs, !subtract);
+  } else {
+    if (subtract) {
+      submul(r, factor(e.lhs), factor(e.rhs));
+    } else {
+      addmul(r, factor(e.lhs), factor(e.rhs));
+    }
+  }
+}
+
+} // namespace detail
+
+template <expression E>
+big_integer evaluate(const E& e) {
+  big_integer result(std::allocator_arg, detail::allocator_of(e));
+  detail::accumulate(result, e, false);
+  return result;
+}
+
+// r = e, reusing the buffer of r unless e refers to it.
+template <expression E>
+big_integer& assign(big_integer& r, const E& e) {
+  if (detail::refers_to(e, r)) {
+    r = evaluate(e);
+  } else {
+    // Copying a zero keeps the buffer, a move would take the one of the zero.
+    static const big_integer zero;
+    r = zero;
+    detail::accumulate(r, e, false);
+  }
+  return r;
+}
+
+template <expression E>
+big_integer& operator+=(big_integer& r, const E& e) {
+  if (detail::refers_to(e, r)) {
+    return r += evaluate(e);
+  }
+  detail::accumulate(r, e, false);
+  return r;
+}
+
+template <expression E>
+big_integer& operator-=(big_integer& r, const E& e) {
+  if (detail::refers_to(e, r)) {
+    return r -= evaluate(e);
+  }
+  detail::accumulate(r, e, true);
+  return r;
+}
+
+template <typename L, typename R>
+  requires detail::operands<L, R>
+auto operator+(L&& lhs, R&& rhs) {
+  return sum<detail::node_t<L>, detail::node_t<R>>(detail::to_node(std::forward<L>(lhs)),
+                                                   detail::to_node(std::forward<R>(rhs)));
+}
+
+template <typename L, typename R>
+  requires detail::operands<L, R>
+auto operator-(L&& lhs, R&& rhs) {
+  return difference<detail::node_t<L>, detail::node_t<R>>(detail::to_node(std::forward<L>(lhs)),
+                                                          detail::to_node(std::forward<R>(rhs)));
+}
+
+template <typename L, typename R>
+  requires detail::operands<L, R>
+auto operator*(L&& lhs, R&& rhs) {
+  return product<detail::node_t<L>, detail::node_t<R>>(detail::to_node(std::forward<L>(lhs)),
+                                                       detail::to_node(std::forward<R>(rhs)));
+}
+
+template <expression E>
+negation<E> operator-(const E& e) {
+  return negation<E>(e);
+}
+
+} // namespace big_integer_expr
@@ -0,0 +1,578 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace limb_vector_detail {
+
+// The two ways a limb_vector lays out its limbs, their number, the capacity and a flag. Heap capacities are always
+// above N, so a capacity of N means the inline limbs are in use. Setting the size keeps the flag and vice versa.
+
+// The N inline limbs overlay the heap pointer, followed by two size_t words and the flag.
+template <typename T, std::size_t N>
+class wide_layout {
+public:
+  static constexpr std::size_t max_size = std::numeric_limits<std::ptrdiff_t>::max() / sizeof(T);
+
+  wide_layout() noexcept : heap(nullptr) {}
+
+  wide_layout(const wide_layout&) = delete;
+  wide_layout& operator=(const wide_layout&) = delete;
+
+  T* data() noexcept {
+    return is_inline() ? inline_limbs : heap;
+  }
+  const T* data() const noexcept {
+    return is_inline() ? inline_limbs : heap;
+  }
+  std::size_t size() const noexcept {
+    return length;
+  }
+  void set_size(std::size_t count) noexcept {
+    length = count;
+  }
+  std::size_t capacity() const noexcept {
+    return allocated;
+  }
+  bool is_inline() const noexcept {
+    return allocated == N;
+  }
+  void set_heap(T* limbs, std::size_t count) noexcept {
+    heap = limbs;
+    allocated = count;
+  }
+  void set_inline() noexcept {
+    allocated = N;
+  }
+  bool flag() const noexcept {
+    return flag_bit;
+  }
+  void set_flag(bool value) noexcept {
+    flag_bit = value;
+  }
+
+private:
+  union {
+    T* heap;
+    T inline_limbs[N];
+  };
+  std::size_t length = 0;
+  std::size_t allocated = N;
+  bool flag_bit = false;
+};
+
+// GMP-style 16 bytes: the inline limbs overlay the heap pointer, the size is a signed 32-bit number whose sign is
+// the flag (kept as ~size, so that an empty vector can carry it as well), and the capacity takes the other 32 bits.
+template <typename T, std::size_t N>
+class compact_layout {
+  static_assert(N * sizeof(T) <= sizeof(T*), "the inline limbs of the compact layout must fit in a pointer");
+
+public:
+  static constexpr std::size_t max_size = std::numeric_limits<std::int32_t>::max();
+
+  compact_layout() noexcept : heap(nullptr) {}
+
+  compact_layout(const compact_layout&) = delete;
+  compact_layout& operator=(const compact_layout&) = delete;
+
+  T* data() noexcept {
+    return is_inline() ? inline_limbs : heap;
+  }
+  const T* data() const noexcept {
+    return is_inline() ? inline_limbs : heap;
+  }
+  std::size_t size() const noexcept {
+    return static_cast<std::size_t>(signed_size < 0 ? ~signed_size : signed_size);
+  }
+  void set_size(std::size_t count) noexcept {
+    auto value = static_cast<std::int32_t>(count);
+    signed_size = (signed_size < 0 ? ~value : value);
+  }
+  std::size_t capacity() const noexcept {
+    return allocated;
+  }
+  bool is_inline() const noexcept {
+    return allocated == N;
+  }
+  void set_heap(T* limbs, std::size_t count) noexcept {
+    heap = limbs;
+    allocated = static_cast<std::uint32_t>(count);
+  }
+  void set_inline() noexcept {
+    allocated = N;
+  }
+  bool flag() const noexcept {
+    return signed_size < 0;
+  }
+  void set_flag(bool value) noexcept {
+    if (value != flag()) {
+      signed_size = ~signed_size;
+    }
+  }
+
+private:
+  union {
+    T* heap;
+    T inline_limbs[N];
+  };
+  std::int32_t signed_size = 0;
+  std::uint32_t allocated = N;
+};
+
+} // namespace limb_vector_detail
+
+// A vector of trivially copyable limbs that keeps up to N of them inline and only allocates when it grows beyond
+// that. Provides the subset of the std::vector interface big_integer needs, with the same semantics: resize()
+// value-initializes new limbs, and moves leave the source empty. The allocator is propagated on copy, move and swap
+// as std::allocator_traits prescribes; when it stays behind and the two allocators differ, limbs are copied instead.
+// Next to the limbs, the vector keeps a flag for its owner (the sign of a big_integer) that is copied, moved and
+// swapped together with them and is otherwise left alone.
+//
+// With ShareThreshold > 0, copies of a heap buffer holding at least that many limbs share it (copy-on-write): heap
+// blocks start with an atomic reference count, and every non-const access to the limbs first gives this vector a
+// buffer of its own if the current one is shared. Pointers and iterators obtained through non-const access stay
+// valid until the vector is copied. Vectors that share a buffer may be used from different threads.
+//
+// Blocks of at least REALLOC_THRESHOLD limbs of a non-sharing vector with std::allocator come from malloc instead,
+// so that growing them goes through realloc: that extends a block in place when it can, and moves large ones by
+// remapping their pages (mremap) rather than copying them next to a second live copy.
+//
+// With Compact, the vector takes 16 bytes besides a stateful allocator (see compact_layout), and holds fewer than
+// 2^31 limbs: growing beyond that throws std::length_error.
+template <typename T, std::size_t N, typename Allocator = std::allocator<T>, std::size_t ShareThreshold = 0,
+          bool Compact = false>
+class limb_vector {
+  static_assert(std::is_trivially_copyable_v<T>);
+  static_assert(N > 0);
+
+  using traits = std::allocator_traits<Allocator>;
+  using layout =
+      std::conditional_t<Compact, limb_vector_detail::compact_layout<T, N>, limb_vector_detail::wide_layout<T, N>>;
+
+  static constexpr bool steals_on_move_assignment =
+      traits::propagate_on_container_move_assignment::value || traits::is_always_equal::value;
+  static constexpr bool steals_on_swap = traits::propagate_on_container_swap::value || traits::is_always_equal::value;
+  static constexpr bool shares = (ShareThreshold > 0);
+  static constexpr bool reallocates = std::is_same_v<Allocator, std::allocator<T>> && !shares;
+
+public:
+  using value_type = T;
+  using allocator_type = Allocator;
+  using size_type = std::size_t;
+  using iterator = T*;
+  using const_iterator = const T*;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  limb_vector() noexcept(noexcept(Allocator())) : limb_vector(Allocator()) {}
+
+  explicit limb_vector(const Allocator& alloc) noexcept : alloc(alloc) {}
+
+  explicit limb_vector(size_type count, const Allocator& alloc = Allocator()) : limb_vector(alloc) {
+    resize(count);
+  }
+
+  limb_vector(size_type count, const T& value, const Allocator& alloc = Allocator()) : limb_vector(alloc) {
+    assign(count, value);
+  }
+
+  limb_vector(const T* from, const T* to, const Allocator& alloc = Allocator()) : limb_vector(alloc) {
+    assign(from, to);
+  }
+
+  limb_vector(const limb_vector& other)
+      : limb_vector(other, traits::select_on_container_copy_construction(other.alloc)) {}
+
+  limb_vector(const limb_vector& other, const Allocator& alloc) : limb_vector(alloc) {
+    if (can_share(other)) {
+      share(other);
+    } else {
+      assign(other.begin(), other.end());
+    }
+    set_flag(other.flag());
+  }
+
+  limb_vector(limb_vector&& other) noexcept : limb_vector(other.alloc) {
+    steal(other);
+  }
+
+  limb_vector(limb_vector&& other, const Allocator& alloc) : limb_vector(alloc) {
+    if (alloc == other.alloc) {
+      steal(other);
+    } else {
+      copy_and_clear(other);
+    }
+  }
+
+  limb_vector& operator=(const limb_vector& other) {
+    if (&other != this) {
+      if constexpr (traits::propagate_on_container_copy_assignment::value) {
+        if (alloc != other.alloc) {
+          release();
+        }
+        alloc = other.alloc;
+      }
+      if (can_share(other)) {
+        if (storage.data() != other.storage.data()) {
+          release();
+          share(other);
+        }
+        storage.set_size(other.size());
+      } else {
+        assign(other.begin(), other.end());
+      }
+      set_flag(other.flag());
+    }
+    return *this;
+  }
+
+  limb_vector& operator=(limb_vector&& other) noexcept(steals_on_move_assignment) {
+    if (&other != this) {
+      if constexpr (steals_on_move_assignment) {
+        release();
+        if constexpr (traits::propagate_on_container_move_assignment::value) {
+          alloc = other.alloc;
+        }
+        steal(other);
+      } else if (alloc == other.alloc) {
+        release();
+        steal(other);
+      } else {
+        copy_and_clear(other);
+      }
+    }
+    return *this;
+  }
+
+  ~limb_vector() {
+    release();
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return alloc;
+  }
+
+  bool flag() const noexcept {
+    return storage.flag();
+  }
+  void set_flag(bool value) noexcept {
+    storage.set_flag(value);
+  }
+
+  T* data() noexcept(!shares) {
+    unshare();
+    return storage.data();
+  }
+  const T* data() const noexcept {
+    return storage.data();
+  }
+  size_type size() const noexcept {
+    return storage.size();
+  }
+  size_type capacity() const noexcept {
+    return storage.capacity();
+  }
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  T& operator[](size_type i) noexcept(!shares) {
+    return data()[i];
+  }
+  const T& operator[](size_type i) const noexcept {
+    return data()[i];
+  }
+  T& back() noexcept(!shares) {
+    return data()[size() - 1];
+  }
+  const T& back() const noexcept {
+    return data()[size() - 1];
+  }
+
+  iterator begin() noexcept(!shares) {
+    return data();
+  }
+  const_iterator begin() const noexcept {
+    return data();
+  }
+  iterator end() noexcept(!shares) {
+    return data() + size();
+  }
+  const_iterator end() const noexcept {
+    return data() + size();
+  }
+  reverse_iterator rbegin() noexcept(!shares) {
+    return reverse_iterator(end());
+  }
+  const_reverse_iterator rbegin() const noexcept {
+    return const_reverse_iterator(end());
+  }
+  reverse_iterator rend() noexcept(!shares) {
+    return reverse_iterator(begin());
+  }
+  const_reverse_iterator rend() const noexcept {
+    return const_reverse_iterator(begin());
+  }
+
+  void reserve(size_type count) {
+    if (count > capacity()) {
+      reallocate(count, size());
+    }
+  }
+
+  void resize(size_type count) {
+    size_type length = size();
+    if (count > length) {
+      reserve(count);
+      unshare();
+      std::fill(storage.data() + length, storage.data() + count, T());
+    }
+    storage.set_size(count);
+  }
+
+  // Like resize(), but leaves the new limbs uninitialized; the caller has to write them before they are read.
+  void resize_for_overwrite(size_type count) {
+    if (count > size()) {
+      reserve(count);
+      unshare();
+    }
+    storage.set_size(count);
+  }
+
+  void clear() noexcept {
+    storage.set_size(0);
+  }
+
+  // Like the other modifiers, leaves the vector unchanged if the allocation throws.
+  void assign(size_type count, const T& value) {
+    prepare_overwrite(count);
+    std::fill(storage.data(), storage.data() + count, value);
+    storage.set_size(count);
+  }
+
+  // [from, to) must not point into this vector.
+  void assign(const T* from, const T* to) {
+    size_type count = to - from;
+    prepare_overwrite(count);
+    if (count != 0) {
+      std::memcpy(storage.data(), from, count * sizeof(T));
+    }
+    storage.set_size(count);
+  }
+
+  void push_back(const T& value) {
+    T copy = value;
+    size_type length = size();
+    if (length == capacity()) {
+      reallocate(length + 1, length);
+    } else {
+      unshare();
+    }
+    storage.data()[length] = copy;
+    storage.set_size(length + 1);
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    push_back(T(std::forward<Args>(args)...));
+    return back();
+  }
+
+  void pop_back() noexcept {
+    storage.set_size(size() - 1);
+  }
+
+  void swap(limb_vector& other) noexcept(steals_on_swap) {
+    if (!steals_on_swap && alloc != other.alloc) {
+      // Each vector keeps its allocator, so the limbs have to be copied across.
+      limb_vector tmp(other, alloc);
+      other.assign(std::as_const(*this).begin(), std::as_const(*this).end());
+      other.set_flag(flag());
+      *this = std::move(tmp);
+      return;
+    }
+    limb_vector tmp(std::move(other));
+    if constexpr (traits::propagate_on_container_swap::value) {
+      other.alloc = alloc;
+      alloc = tmp.alloc;
+    }
+    other.steal(*this);
+    steal(tmp);
+  }
+
+  friend void swap(limb_vector& a, limb_vector& b) noexcept(steals_on_swap) {
+    a.swap(b);
+  }
+
+  // Compares the limbs only.
+  friend bool operator==(const limb_vector& a, const limb_vector& b) noexcept {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+  }
+
+private:
+  static constexpr size_type REALLOC_THRESHOLD = (size_type(1) << 16) / sizeof(T);
+
+  static bool is_malloced(size_type count) noexcept {
+    return reallocates && count >= REALLOC_THRESHOLD;
+  }
+
+  // Heap blocks of sharing vectors are allocated in units aligned for both the reference count and the limbs:
+  // the count takes the first unit, the limbs start at the second one.
+  using counter = std::atomic<size_type>;
+  struct alignas(counter) alignas(T) unit {
+    unsigned char bytes[std::max(sizeof(counter), sizeof(T))];
+  };
+  using unit_allocator = typename traits::template rebind_alloc<unit>;
+  using unit_traits = std::allocator_traits<unit_allocator>;
+
+  static size_type units_for(size_type count) noexcept {
+    return 1 + (count * sizeof(T) + sizeof(unit) - 1) / sizeof(unit);
+  }
+
+  T* allocate_block(size_type count) {
+    if constexpr (shares) {
+      unit_allocator units(alloc);
+      unit* block = unit_traits::allocate(units, units_for(count));
+      ::new (static_cast<void*>(block)) counter(1);
+      return reinterpret_cast<T*>(block + 1);
+    } else if (is_malloced(count)) {
+      void* block = std::malloc(count * sizeof(T));
+      if (block == nullptr) {
+        throw std::bad_alloc();
+      }
+      return static_cast<T*>(block);
+    } else {
+      return traits::allocate(alloc, count);
+    }
+  }
+
+  void deallocate_block(T* limbs, size_type count) noexcept {
+    if constexpr (shares) {
+      unit_allocator units(alloc);
+      unit* block = reinterpret_cast<unit*>(limbs) - 1;
+      references(limbs).~counter();
+      unit_traits::deallocate(units, block, units_for(count));
+    } else if (is_malloced(count)) {
+      std::free(limbs);
+    } else {
+      traits::deallocate(alloc, limbs, count);
+    }
+  }
+
+  static counter& references(const T* limbs) noexcept {
+    return *std::launder(reinterpret_cast<counter*>(reinterpret_cast<unit*>(const_cast<T*>(limbs)) - 1));
+  }
+
+  bool is_inline() const noexcept {
+    return storage.is_inline();
+  }
+
+  bool is_shared() const noexcept {
+    if constexpr (shares) {
+      return !is_inline() && references(storage.data()).load(std::memory_order_acquire) != 1;
+    } else {
+      return false;
+    }
+  }
+
+  bool can_share(const limb_vector& other) const noexcept {
+    return shares && !other.is_inline() && other.size() >= ShareThreshold && alloc == other.alloc;
+  }
+
+  // Starts sharing the buffer of other; *this must be inline.
+  void share(const limb_vector& other) noexcept {
+    references(other.storage.data()).fetch_add(1, std::memory_order_relaxed);
+    storage.set_heap(const_cast<T*>(other.storage.data()), other.capacity());
+    storage.set_size(other.size());
+  }
+
+  // Makes the buffer writable: a shared one is replaced by a copy that this vector owns alone.
+  void unshare() {
+    if (is_shared()) {
+      reallocate(capacity(), size());
+    }
+  }
+
+  // Makes room for count limbs that replace the current ones.
+  void prepare_overwrite(size_type count) {
+    if (is_shared() && count <= N) {
+      release();
+    } else if (count > capacity() || is_shared()) {
+      reallocate(count, 0);
+    }
+  }
+
+  // Moves to a block of at least `count` limbs keeping the first `keep` of them; nothing changes if this throws.
+  void reallocate(size_type count, size_type keep) {
+    if (count > layout::max_size) {
+      throw std::length_error("limb_vector: too many limbs");
+    }
+    if (!is_shared()) {
+      count = std::max(count, std::min(capacity() * 2, layout::max_size));
+    }
+    if (keep != 0 && is_malloced(capacity())) {
+      // The block only grows here, so the new one comes from malloc as well.
+      void* block = std::realloc(storage.data(), count * sizeof(T));
+      if (block == nullptr) {
+        throw std::bad_alloc();
+      }
+      storage.set_heap(static_cast<T*>(block), count);
+      return;
+    }
+    T* limbs = allocate_block(count);
+    if (keep != 0) {
+      std::memcpy(limbs, storage.data(), keep * sizeof(T));
+    }
+    release();
+    storage.set_heap(limbs, count);
+  }
+
+  void release() noexcept {
+    if (!is_inline()) {
+      // The last owner of a shared buffer frees it; acq_rel orders the other owners' reads before that.
+      T* limbs = storage.data();
+      if (!shares || references(limbs).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        deallocate_block(limbs, capacity());
+      }
+      storage.set_inline();
+    }
+  }
+
+  // Takes the contents and the flag of other, which is left empty with a cleared flag; *this must be empty and
+  // inline, and its allocator must be able to free the memory of other.
+  void steal(limb_vector& other) noexcept {
+    size_type length = other.size();
+    if (other.is_inline()) {
+      std::copy(other.storage.data(), other.storage.data() + length, storage.data());
+    } else {
+      storage.set_heap(other.storage.data(), other.capacity());
+      other.storage.set_inline();
+    }
+    storage.set_size(length);
+    set_flag(other.flag());
+    other.storage.set_size(0);
+    other.set_flag(false);
+  }
+
+  // The move from other when the memory has to stay with its allocator: copies, then leaves other as steal() does.
+  void copy_and_clear(limb_vector& other) {
+    assign(std::as_const(other).begin(), std::as_const(other).end());
+    set_flag(other.flag());
+    other.clear();
+    other.set_flag(false);
+  }
+
+  layout storage;
+  [[no_unique_address]] Allocator alloc;
+};
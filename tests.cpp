@@ -1,13 +1,17 @@
 #include "big_integer.h"
+#include "big_integer_expr.h"
 #include "gtest/gtest.h"
 
 #include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstdlib>
+#include <iomanip>
 #include <limits>
 #include <string>
 #include <random>
+#include <sstream>
+#include <utility>
 
 namespace {
 
@@ -83,6 +87,34 @@ TEST(correctness, copy_ctor_real_copy2) {
   EXPECT_EQ(3, a);
 }
 
+TEST(correctness, copy_ctor_real_copy_long) {
+  big_integer a = (big_integer(7) << 20000) + 1;
+  big_integer b = a;
+  big_integer c = b;
+  b += 1;
+  EXPECT_EQ(c, a);
+  EXPECT_EQ(b - 1, a);
+  c += c;
+  EXPECT_EQ(c, a * 2);
+  c = a;
+  c >>= 20000;
+  EXPECT_EQ(c, 7);
+  c = a;
+  c &= a;
+  EXPECT_EQ(c, a);
+  c ^= c;
+  EXPECT_EQ(c, 0);
+
+  std::vector<big_integer> copies(100, a);
+  copies[10] *= 2;
+  copies[11] = copies[10];
+  copies[11] -= a;
+  EXPECT_EQ(copies[9], a);
+  EXPECT_EQ(copies[10], a * 2);
+  EXPECT_EQ(copies[11], a);
+  EXPECT_EQ(a % 7, 1);
+}
+
 TEST(correctness, ctor_invalid_string) {
   EXPECT_THROW(big_integer("abc"), std::invalid_argument);
   EXPECT_THROW(big_integer("123x"), std::invalid_argument);
@@ -94,6 +126,26 @@ TEST(correctness, ctor_invalid_string) {
   EXPECT_THROW(big_integer("++5"), std::invalid_argument);
 }
 
+TEST(correctness, ctor_invalid_string_long) {
+  for (size_t pos = 0; pos < 70; ++pos) {
+    for (char bad : {'/', ':', ' ', '\xB0'}) {
+      std::string str(70, '7');
+      str[pos] = bad;
+      EXPECT_THROW(big_integer{str}, std::invalid_argument);
+    }
+  }
+}
+
+TEST(correctness, string_ctor_digit_groups) {
+  EXPECT_EQ(12345678, big_integer("12345678"));
+  EXPECT_EQ(1234567890123456LL, big_integer("1234567890123456"));
+  EXPECT_EQ(12345678901234567LL, big_integer("12345678901234567"));
+  EXPECT_EQ(999999999999999999LL, big_integer("999999999999999999"));
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), big_integer("18446744073709551615"));
+  EXPECT_EQ(big_integer("1000000000000000000") * big_integer("1000000000000000000") + big_integer(90807060504030201LL),
+            big_integer("1000000000000000000090807060504030201"));
+}
+
 TEST(correctness, assignment_operator) {
   big_integer a = 4;
   big_integer b = 7;
@@ -118,6 +170,237 @@ TEST(correctness, assignment_return_value) {
   EXPECT_TRUE(b == 7);
 }
 
+TEST(correctness, move_ctor) {
+  static_assert(std::is_nothrow_move_constructible_v<big_integer>);
+#if !BIG_INTEGER_PMR
+  // With memory resources a move between two of them copies.
+  static_assert(std::is_nothrow_move_assignable_v<big_integer>);
+  static_assert(std::is_nothrow_swappable_v<big_integer>);
+#endif
+
+  big_integer a("-123456789012345678901234567890");
+  big_integer b = std::move(a);
+  EXPECT_EQ(b, big_integer("-123456789012345678901234567890"));
+  EXPECT_EQ(a, 0);
+  a += 5;
+  EXPECT_EQ(a, 5);
+}
+
+TEST(correctness, move_assignment) {
+  big_integer a("123456789012345678901234567890");
+  big_integer b = -7;
+  b = std::move(a);
+  EXPECT_EQ(b, big_integer("123456789012345678901234567890"));
+  EXPECT_EQ(a, 0);
+
+  big_integer& c = b;
+  b = std::move(c);
+  EXPECT_EQ(b, big_integer("123456789012345678901234567890"));
+
+  using std::swap;
+  swap(a, b);
+  EXPECT_EQ(a, big_integer("123456789012345678901234567890"));
+  EXPECT_EQ(b, 0);
+
+  std::vector<big_integer> values;
+  for (int i = 0; i < 100; ++i) {
+    values.push_back(big_integer(i) << 100);
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(values[i] >> 100, i);
+  }
+}
+
+TEST(correctness, inline_limbs) {
+#if !BIG_INTEGER_PMR && !BIG_INTEGER_COMPACT_LAYOUT && !BIG_INTEGER_64BIT_LIMBS && BIG_INTEGER_INLINE_LIMBS == 2
+  // The inline limbs overlay the heap pointer: as large as the std::vector and bool of a plain big_integer.
+  static_assert(sizeof(big_integer) == 32);
+#endif
+  // Values move between inline and heap storage as they grow and shrink.
+  big_integer a = 1;
+  std::vector<big_integer> powers;
+  for (int i = 0; i < 200; ++i) {
+    powers.push_back(a);
+    a *= -3;
+  }
+  for (int i = 199; i > 0; --i) {
+    a /= -3;
+    EXPECT_EQ(a, powers[i]);
+    big_integer b = powers[i];
+    big_integer c = std::move(b);
+    b = powers[i - 1];
+    swap(b, c);
+    EXPECT_EQ(b, powers[i]);
+    EXPECT_EQ(c, powers[i - 1]);
+  }
+  big_integer x = big_integer(UINT64_MAX);
+  EXPECT_EQ(x + 1, big_integer(1) << 64);
+  EXPECT_EQ((x + 1) - 1, x);
+  EXPECT_EQ(x * x, (big_integer(1) << 128) - (big_integer(1) << 65) + 1);
+}
+
+TEST(correctness, sign_follows_limbs) {
+#if BIG_INTEGER_COMPACT_LAYOUT && !BIG_INTEGER_PMR
+  static_assert(sizeof(big_integer) == 16);
+#endif
+  big_integer small = -5;
+  big_integer large = -(big_integer(1) << 300);
+  big_integer positive = big_integer(1) << 300;
+
+  swap(small, positive);
+  EXPECT_EQ(small, big_integer(1) << 300);
+  EXPECT_EQ(positive, -5);
+  swap(small, large);
+  EXPECT_EQ(small, -(big_integer(1) << 300));
+  EXPECT_EQ(large, big_integer(1) << 300);
+
+  big_integer moved = std::move(small);
+  EXPECT_EQ(moved, -(big_integer(1) << 300));
+  EXPECT_EQ(small, 0);
+  EXPECT_EQ(small + 1, 1);
+  small = std::move(positive);
+  EXPECT_EQ(small, -5);
+  EXPECT_EQ(positive, 0);
+  EXPECT_EQ(positive - 1, -1);
+
+  moved = large;
+  EXPECT_EQ(moved, large);
+  moved *= moved;
+  EXPECT_EQ(moved, big_integer(1) << 600);
+  moved = -moved;
+  moved *= moved;
+  EXPECT_EQ(moved, big_integer(1) << 1200);
+  moved *= small;
+  EXPECT_EQ(moved, -(big_integer(5) << 1200));
+  moved *= 0;
+  EXPECT_EQ(moved, 0);
+  EXPECT_EQ(moved - 1, -1);
+}
+
+TEST(correctness, allocator_ctors) {
+  big_integer::allocator_type alloc;
+  big_integer a(std::allocator_arg, alloc, "-123456789012345678901234567890");
+  big_integer b(std::allocator_arg, alloc, a);
+  big_integer c(std::allocator_arg, alloc, std::move(b));
+  big_integer d(std::allocator_arg, alloc, "ff", 16);
+  big_integer e(std::allocator_arg, alloc);
+  EXPECT_EQ(a, big_integer("-123456789012345678901234567890"));
+  EXPECT_EQ(b, 0);
+  EXPECT_EQ(c, a);
+  EXPECT_EQ(d, 255);
+  EXPECT_EQ(e, 0);
+  EXPECT_TRUE(a.get_allocator() == alloc);
+}
+
+#if BIG_INTEGER_PMR
+namespace {
+
+class counting_resource : public std::pmr::memory_resource {
+public:
+  size_t allocations = 0;
+  size_t bytes_in_use = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    bytes_in_use += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    bytes_in_use -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+} // namespace
+
+TEST(correctness, pmr_propagation) {
+  counting_resource arena;
+  counting_resource fallback;
+  std::pmr::memory_resource* previous = std::pmr::set_default_resource(&fallback);
+  {
+    big_integer a(std::allocator_arg, &arena, big_integer(3) << 1000);
+    EXPECT_EQ(a.get_allocator().resource(), &arena);
+
+    // Results take the resource of their (left) big_integer operand.
+    big_integer b = a * a + a - 1;
+    EXPECT_EQ(b.get_allocator().resource(), &arena);
+    EXPECT_EQ((b / a).get_allocator().resource(), &arena);
+    EXPECT_EQ((b << 100).get_allocator().resource(), &arena);
+    EXPECT_EQ((5 + b).get_allocator().resource(), &arena);
+    EXPECT_EQ((-b).get_allocator().resource(), &arena);
+
+    // A right operand only lends its buffer to the result if it comes from the same resource, and
+    // a chain of operators allocates once.
+    big_integer e(std::allocator_arg, &fallback, 7);
+    EXPECT_EQ((a - std::move(e)).get_allocator().resource(), &arena);
+    size_t before = arena.allocations;
+    big_integer sum = a + a + a + a;
+    EXPECT_EQ(arena.allocations, before + 1);
+    EXPECT_EQ(sum, a * 4);
+
+    // Copies take the default resource, moves keep theirs, assignment and swap never change it.
+    big_integer c = b;
+    EXPECT_EQ(c.get_allocator().resource(), &fallback);
+    big_integer d = std::move(b);
+    EXPECT_EQ(d.get_allocator().resource(), &arena);
+    c = std::move(d);
+    EXPECT_EQ(c.get_allocator().resource(), &fallback);
+    EXPECT_EQ(c, a * a + a - 1);
+    swap(a, c);
+    EXPECT_EQ(a.get_allocator().resource(), &arena);
+    EXPECT_EQ(c.get_allocator().resource(), &fallback);
+    EXPECT_EQ(c, big_integer(3) << 1000);
+
+    // pmr containers pass their resource on to the elements.
+    std::pmr::vector<big_integer> values(&arena);
+    values.emplace_back(c);
+    values.push_back(c * c);
+    values.emplace_back("123456789012345678901234567890123456789");
+    for (const big_integer& value : values) {
+      EXPECT_EQ(value.get_allocator().resource(), &arena);
+    }
+
+    size_t used = fallback.bytes_in_use;
+    a *= a;
+    a += 1;
+    a /= 7;
+    EXPECT_EQ(fallback.bytes_in_use, used);
+    EXPECT_GT(arena.allocations, 0);
+  }
+  std::pmr::set_default_resource(previous);
+  EXPECT_EQ(arena.bytes_in_use, 0);
+  EXPECT_EQ(fallback.bytes_in_use, 0);
+}
+
+TEST(correctness, pmr_power_cache) {
+  std::string digits(20000, '7');
+  digits.front() = '1';
+  big_integer::clear_power_cache();
+  {
+    // The powers cached by a conversion outlive the default resource that is current while it runs, so they
+    // must hold nothing from it.
+    counting_resource scoped;
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(&scoped);
+    {
+      big_integer a(digits);
+      EXPECT_EQ(to_string(a), digits);
+    }
+    std::pmr::set_default_resource(previous);
+    EXPECT_GT(scoped.allocations, 0);
+    EXPECT_EQ(scoped.bytes_in_use, 0);
+  }
+  big_integer b(digits);
+  EXPECT_EQ(to_string(b), digits);
+  EXPECT_EQ(b % 1000, 777);
+}
+#endif
+
 TEST(correctness, comparisons) {
   big_integer a = 100;
   big_integer b = 100;
@@ -291,6 +574,53 @@ TEST(correctness, div_return_value) {
   EXPECT_EQ(25, a);
 }
 
+TEST(correctness, divmod_rounding_modes) {
+  using rounding = big_integer::rounding;
+  big_integer q, r;
+  const int values[][2] = {{23, 5}, {-23, 5}, {23, -5}, {-23, -5}, {20, 5}, {-20, 5}, {3, 7}, {-3, 7}};
+  for (auto [a, b] : values) {
+    divmod(q, r, a, b, rounding::trunc);
+    EXPECT_EQ(a / b, q);
+    EXPECT_EQ(a % b, r);
+
+    divmod(q, r, a, b, rounding::floor);
+    int fq = a / b - ((a % b != 0 && (a < 0) != (b < 0)) ? 1 : 0);
+    EXPECT_EQ(fq, q);
+    EXPECT_EQ(a - fq * b, r);
+
+    divmod(q, r, a, b, rounding::ceil);
+    int cq = a / b + ((a % b != 0 && (a < 0) == (b < 0)) ? 1 : 0);
+    EXPECT_EQ(cq, q);
+    EXPECT_EQ(a - cq * b, r);
+
+    divmod(q, r, a, b, rounding::euclid);
+    EXPECT_TRUE(r >= 0);
+    EXPECT_TRUE(r < (b < 0 ? -b : b));
+    EXPECT_EQ(big_integer(a), q * b + r);
+  }
+}
+
+TEST(correctness, divmod_long_aliasing) {
+  big_integer a("-1000000000000000000000000000000000000000000000000000000000000"
+                "0000000000000000000000000000007");
+  big_integer b("100000000000000000000000000000000000000");
+  big_integer q = a;
+  big_integer r = b;
+  divmod(q, r, q, r, big_integer::rounding::floor);
+  EXPECT_EQ(big_integer("-100000000000000000000000000000000000000000000000000001"), q);
+  EXPECT_EQ(big_integer("99999999999999999999999999999999999993"), r);
+
+  div_r(a, a, b, big_integer::rounding::euclid);
+  EXPECT_EQ(r, a);
+  div_q(b, b, 7);
+  EXPECT_EQ(big_integer("14285714285714285714285714285714285714"), b);
+}
+
+TEST(correctness, divmod_by_zero) {
+  big_integer q, r;
+  EXPECT_THROW(divmod(q, r, 1, 0), std::domain_error);
+}
+
 TEST(correctness, unary_plus) {
   big_integer a = 123;
   big_integer b = +a;
@@ -489,6 +819,69 @@ TEST(correctness, shr_return_value) {
   EXPECT_EQ(8, a);
 }
 
+TEST(correctness, shift_2exp) {
+  big_integer a("-3417856182746231874623148723164812376512852437523846123876");
+  big_integer q;
+  fdiv_q_2exp(q, a, 31);
+  EXPECT_EQ(a >> 31, q);
+  EXPECT_EQ(big_integer("-1591563309890326054125627839548891585559049824963"), q);
+  tdiv_q_2exp(q, a, 31);
+  EXPECT_EQ(big_integer("-1591563309890326054125627839548891585559049824962"), q);
+
+  fdiv_q_2exp(q, -5, 1ull << 40);
+  EXPECT_EQ(-1, q);
+  tdiv_q_2exp(q, -5, 1ull << 40);
+  EXPECT_EQ(0, q);
+
+  big_integer r;
+  mod_2exp(r, -5, 3);
+  EXPECT_EQ(3, r);
+  mod_2exp(r, 13, 3);
+  EXPECT_EQ(5, r);
+  mod_2exp(r, -1, 64);
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), r);
+  big_integer low = a;
+  mod_2exp(low, low, 31);
+  EXPECT_EQ(1458581148, low);
+  EXPECT_EQ(a, (a >> 31 << 31) + low);
+
+  big_integer p;
+  mul_2exp(p, -3, 100);
+  EXPECT_EQ(big_integer("-3802951800684688204490109616128"), p);
+}
+
+TEST(correctness, limb_boundaries) {
+  big_integer two_64 = big_integer(1) << 64;
+  big_integer a;
+  a += -5;
+  EXPECT_EQ(-5, a);
+  a -= 7;
+  EXPECT_EQ(-12, a);
+  a = 0;
+  a -= 3;
+  EXPECT_EQ(-3, a);
+
+  a = 1;
+  a += int64_t(1) << 40;
+  EXPECT_EQ(big_integer("1099511627777"), a);
+  a -= std::numeric_limits<int64_t>::min();
+  EXPECT_EQ(big_integer("9223373136366403585"), a);
+  a *= std::numeric_limits<int64_t>::min();
+  EXPECT_EQ(big_integer("-85070601871439417700902235868422471680"), a);
+  a *= 0;
+  EXPECT_EQ(0, a);
+  EXPECT_EQ("0", to_string(a));
+  EXPECT_EQ(5 - two_64, -(two_64 - 5));
+  EXPECT_EQ(two_64 - 1, 0 - (1 - two_64));
+
+  EXPECT_EQ(two_64 + 1, 1 | two_64);
+  EXPECT_EQ(two_64 + 1, 1 ^ two_64);
+  EXPECT_EQ(0, 1 & two_64);
+  EXPECT_EQ(-two_64, -two_64 & -two_64);
+  EXPECT_EQ(-(big_integer(1) << 32), big_integer(-1) << 32 & -(big_integer(1) << 32));
+  EXPECT_EQ(-1, -two_64 | (two_64 - 1));
+}
+
 TEST(correctness, add_long) {
   big_integer a("10000000000000000000000000000000000000000000000000000000000000"
                 "000000000000000000000000000000");
@@ -618,6 +1011,128 @@ TEST(correctness, div_long_signed2) {
   EXPECT_EQ(c, a / b);
 }
 
+TEST(correctness, mul_div_mixed_sizes) {
+  // Operations on small numbers run between and inside the ones on large numbers and share their scratch space.
+  big_integer big = (big_integer(3) << 40000) + 7;
+  big_integer small = (big_integer(5) << 3000) + 11;
+  for (int i = 0; i < 3; ++i) {
+    big_integer product = big * small;
+    EXPECT_EQ(product / small, big);
+    EXPECT_EQ(product % big, 0);
+    EXPECT_EQ((small * small + 1) % small, 1);
+    EXPECT_EQ(product * product / big, product * small);
+  }
+}
+
+TEST(correctness, rvalue_operands) {
+  // Every combination of lvalue and rvalue operands gives the same result, whichever operand's buffer is reused.
+  const big_integer values[] = {0, 7, -3, big_integer(5) << 200, -(big_integer(9) << 300) + 1};
+  auto r = [](const big_integer& x) { return big_integer(x); };
+  for (const big_integer& a : values) {
+    for (const big_integer& b : values) {
+      EXPECT_EQ(r(a) + b, a + b);
+      EXPECT_EQ(a + r(b), a + b);
+      EXPECT_EQ(r(a) + r(b), a + b);
+      EXPECT_EQ(r(a) - b, a - b);
+      EXPECT_EQ(a - r(b), a - b);
+      EXPECT_EQ(r(a) - r(b), a - b);
+      EXPECT_EQ(r(a) * b, a * b);
+      EXPECT_EQ(a * r(b), a * b);
+      EXPECT_EQ(r(a) * r(b), a * b);
+      EXPECT_EQ(r(a) & b, a & b);
+      EXPECT_EQ(a | r(b), a | b);
+      EXPECT_EQ(r(a) ^ r(b), a ^ b);
+      if (b != 0) {
+        EXPECT_EQ(r(a) / b, a / b);
+        EXPECT_EQ(a / r(b), a / b);
+        EXPECT_EQ(r(a) % r(b), a % b);
+        EXPECT_EQ(a % r(b), a % b);
+      }
+    }
+    EXPECT_EQ(r(a) + 5, a + 5);
+    EXPECT_EQ(5 - r(a), -(a - 5));
+    EXPECT_EQ(5 - a, -(a - 5));
+    EXPECT_EQ(-3 * r(a), a * -3);
+    EXPECT_EQ(r(a) << 70, a << 70);
+    EXPECT_EQ(r(a) >> 70, a >> 70);
+  }
+
+  big_integer x = big_integer(1) << 500;
+  big_integer y = std::move(x) + std::move(x);
+  EXPECT_EQ(y, big_integer(1) << 501);
+  EXPECT_EQ(INT64_MIN - big_integer(1), big_integer(INT64_MIN) - 1);
+}
+
+TEST(correctness, addmul_submul) {
+  const big_integer values[] = {0, 3, -7, big_integer(5) << 40, -(big_integer(9) << 100) + 1,
+                                (big_integer(7) << 3000) - 1};
+  for (const big_integer& r : values) {
+    for (const big_integer& a : values) {
+      for (const big_integer& b : values) {
+        big_integer x = r;
+        addmul(x, a, b);
+        EXPECT_EQ(x, r + a * b);
+        x = r;
+        submul(x, a, b);
+        EXPECT_EQ(x, r - a * b);
+      }
+    }
+  }
+  big_integer x = big_integer(3) << 100;
+  addmul(x, x, x);
+  EXPECT_EQ(x, (big_integer(3) << 100) + (big_integer(9) << 200));
+  submul(x, x, 2);
+  EXPECT_EQ(x, -(big_integer(3) << 100) - (big_integer(9) << 200));
+}
+
+TEST(correctness, expression_templates) {
+  using big_integer_expr::lazy;
+  big_integer a = (big_integer(7) << 300) + 5;
+  big_integer b = -(big_integer(3) << 200);
+  big_integer c = big_integer(11) << 1000;
+  big_integer d = 13;
+  big_integer e = (big_integer(1) << 2000) - 1;
+
+  big_integer r = lazy(a) * b + lazy(c) * d - e;
+  EXPECT_EQ(r, a * b + c * d - e);
+  EXPECT_EQ(big_integer(-lazy(a) * 3 - b + 7), -a * 3 - b + 7);
+  EXPECT_EQ(big_integer(lazy(a) * (lazy(b) + c) * d), a * (b + c) * d);
+  EXPECT_EQ(big_integer(lazy(a) - (lazy(b) - lazy(c) * e)), a - (b - c * e));
+  EXPECT_EQ(big_integer(lazy(a + b) * (c - d)), (a + b) * (c - d));
+
+  r = 1;
+  r += lazy(a) * a;
+  EXPECT_EQ(r, a * a + 1);
+  r -= lazy(r) * 2 + e;
+  EXPECT_EQ(r, -(a * a + 1) - e);
+  assign(r, lazy(c) * d - a);
+  EXPECT_EQ(r, c * d - a);
+  assign(r, lazy(r) * r - r);
+  EXPECT_EQ(r, (c * d - a) * (c * d - a) - (c * d - a));
+}
+
+TEST(correctness, growth_keeps_limbs) {
+  // Values grow in place past the size where their blocks start to be reallocated; the limbs kept must survive.
+  big_integer ones = 0;
+  uint64_t bits = 0;
+  for (uint64_t step = 1000; bits < 2'000'000; step *= 2) {
+    ones = (ones << static_cast<int>(step)) + ((big_integer(1) << static_cast<int>(step)) - 1);
+    bits += step;
+  }
+  big_integer power = 1;
+  mul_2exp(power, power, bits);
+  EXPECT_EQ(ones + 1, power);
+  EXPECT_EQ(~ones, -power);
+  EXPECT_EQ((ones | power) - power, ones);
+
+  big_integer doubled = ones;
+  for (int i = 0; i < 40; ++i) {
+    doubled += doubled;
+  }
+  EXPECT_EQ(doubled >> 40, ones);
+  EXPECT_EQ(doubled - (ones << 40), 0);
+}
+
 TEST(correctness, negation_long) {
   big_integer a("10000000000000000000000000000000000000000000000000000");
   big_integer c("-10000000000000000000000000000000000000000000000000000");
@@ -666,6 +1181,297 @@ TEST(correctness, string_conv) {
   EXPECT_EQ("-2147483649", to_string(lim));
 }
 
+TEST(correctness, string_conv_long) {
+  big_integer p = 1;
+  for (int i = 0; i < 3000; ++i) {
+    p *= 10;
+  }
+  EXPECT_EQ("1" + std::string(3000, '0'), to_string(p));
+  EXPECT_EQ(std::string(3000, '9'), to_string(p - 1));
+  EXPECT_EQ("-" + std::string(3000, '9'), to_string(big_integer(1) - p));
+  EXPECT_EQ("1" + std::string(2999, '0') + "1", to_string(p + 1));
+
+  std::mt19937 rng(42);
+  std::string digits(5000, '0');
+  for (char& c : digits) {
+    c = static_cast<char>('0' + rng() % 10);
+  }
+  digits[0] = '7';
+  digits[1234] = digits[1235] = digits[1236] = '0';
+  EXPECT_EQ(digits, to_string(big_integer(digits)));
+  EXPECT_EQ("-" + digits, to_string(big_integer("-" + digits)));
+}
+
+TEST(correctness, to_string_parallel) {
+  std::mt19937 rng(7);
+  std::string digits(100000, '0');
+  for (char& c : digits) {
+    c = static_cast<char>('0' + rng() % 10);
+  }
+  digits[0] = '3';
+  big_integer a(digits);
+  EXPECT_EQ(digits, to_string(a, 10, 4));
+  EXPECT_EQ("-" + digits, to_string(-a, 10, 0));
+  EXPECT_EQ(to_string(a, 36), to_string(a, 36, 3));
+  EXPECT_EQ("-42", to_string(big_integer(-42), 10, 8));
+}
+
+TEST(correctness, string_ctor_parallel) {
+  std::mt19937 rng(11);
+  std::string digits(100000, '0');
+  for (char& c : digits) {
+    c = static_cast<char>('0' + rng() % 10);
+  }
+  big_integer a(digits);
+  EXPECT_EQ(a, big_integer(digits, 10, 4));
+  EXPECT_EQ(-a, big_integer("-" + digits, 10, 0));
+  std::string base7 = to_string(a, 7);
+  big_integer b;
+  EXPECT_EQ(std::errc(), from_chars(base7.data(), base7.data() + base7.size(), b, 7, 3).ec);
+  EXPECT_EQ(a, b);
+  EXPECT_THROW(big_integer(digits + "x", 10, 2), std::invalid_argument);
+}
+
+TEST(correctness, string_conv_chunk_boundaries) {
+  big_integer p = 1;
+  uint64_t small = 1;
+  for (size_t k = 0; k < 60; ++k) {
+    EXPECT_EQ("1" + std::string(k, '0'), to_string(p));
+    if (k > 0) {
+      EXPECT_EQ(std::string(k, '9'), to_string(p - 1));
+    }
+    EXPECT_EQ("-1" + std::string(k, '0'), to_string(-p));
+    if (k < 19) {
+      EXPECT_EQ(std::to_string(small + 12345), to_string(p + 12345));
+      small *= 10;
+    }
+    p *= 10;
+  }
+}
+
+TEST(correctness, string_ctor_long) {
+  big_integer p = 1;
+  for (int i = 0; i < 5000; ++i) {
+    p *= 10;
+  }
+  EXPECT_EQ(p, big_integer("1" + std::string(5000, '0')));
+  EXPECT_EQ(p - 1, big_integer(std::string(5000, '9')));
+  EXPECT_EQ(-p - 1, big_integer("-" + std::string(4000, '0') + "1" + std::string(4999, '0') + "1"));
+  EXPECT_THROW(big_integer(std::string(4000, '1') + "x" + std::string(4000, '1')), std::invalid_argument);
+}
+
+TEST(correctness, to_chars) {
+  big_integer p = 1;
+  for (int i = 0; i < 3000; ++i) {
+    p *= 10;
+  }
+  std::string expected = "-" + std::string(3000, '9');
+  std::string buf(expected.size() + 1, '#');
+
+  std::to_chars_result result = to_chars(buf.data(), buf.data() + buf.size(), big_integer(1) - p);
+  EXPECT_EQ(std::errc(), result.ec);
+  EXPECT_EQ(expected, std::string(buf.data(), result.ptr));
+
+  result = to_chars(buf.data(), buf.data() + expected.size() - 1, big_integer(1) - p);
+  EXPECT_EQ(std::errc::value_too_large, result.ec);
+  EXPECT_EQ(buf.data() + expected.size() - 1, result.ptr);
+
+  result = to_chars(buf.data(), buf.data() + 1, big_integer());
+  EXPECT_EQ(std::errc(), result.ec);
+  EXPECT_EQ("0", std::string(buf.data(), result.ptr));
+  EXPECT_EQ(std::errc::value_too_large, to_chars(buf.data(), buf.data(), big_integer()).ec);
+}
+
+TEST(correctness, from_chars) {
+  std::string_view str = "-00123456789012345678901234567890 tail";
+  big_integer a;
+  std::from_chars_result result = from_chars(str.data(), str.data() + str.size(), a);
+  EXPECT_EQ(std::errc(), result.ec);
+  EXPECT_EQ(" tail", std::string_view(result.ptr));
+  EXPECT_EQ(big_integer("-123456789012345678901234567890"), a);
+
+  for (std::string_view bad : {"", "-", "+1", "x1", "-x"}) {
+    big_integer b = 42;
+    result = from_chars(bad.data(), bad.data() + bad.size(), b);
+    EXPECT_EQ(std::errc::invalid_argument, result.ec);
+    EXPECT_EQ(bad.data(), result.ptr);
+    EXPECT_EQ(42, b);
+  }
+
+  str = "-0";
+  EXPECT_EQ(std::errc(), from_chars(str.data(), str.data() + str.size(), a).ec);
+  EXPECT_EQ("0", to_string(a));
+  EXPECT_EQ(big_integer(12345), big_integer(std::string_view("123456").substr(0, 5)));
+}
+
+TEST(correctness, string_conv_bases) {
+  EXPECT_EQ("-ff", to_string(big_integer(-255), 16));
+  EXPECT_EQ("11111111", to_string(big_integer(255), 2));
+  EXPECT_EQ("377", to_string(big_integer(255), 8));
+  EXPECT_EQ("73", to_string(big_integer(255), 36));
+  EXPECT_EQ("100110", to_string(big_integer(255), 3));
+  EXPECT_EQ(big_integer(-255), big_integer("-Ff", 16));
+  EXPECT_EQ(big_integer(1295), big_integer("zZ", 36));
+  EXPECT_EQ(0, big_integer("-0000", 2));
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), big_integer("ffffffffffffffff", 16));
+
+  EXPECT_THROW(big_integer("12", 2), std::invalid_argument);
+  EXPECT_THROW(big_integer("g", 16), std::invalid_argument);
+  EXPECT_THROW(big_integer("1", 37), std::invalid_argument);
+  EXPECT_THROW(to_string(big_integer(1), 1), std::invalid_argument);
+  char buf[4];
+  EXPECT_EQ(std::errc::invalid_argument, to_chars(buf, buf + 4, big_integer(1), 0).ec);
+}
+
+TEST(correctness, digit_count) {
+  EXPECT_EQ(1u, big_integer().exact_digit_count());
+  EXPECT_EQ(1u, big_integer().size_in_base(10));
+  EXPECT_EQ(8u, big_integer(255).size_in_base(2));
+  EXPECT_EQ(2u, big_integer(-255).size_in_base(16));
+  EXPECT_EQ(3u, big_integer(-255).exact_digit_count());
+  EXPECT_THROW(big_integer(1).size_in_base(1), std::invalid_argument);
+
+  big_integer p = 1;
+  for (size_t k = 1; k < 2000; ++k) {
+    p *= 10;
+    EXPECT_EQ(k + 1, p.exact_digit_count());
+    EXPECT_EQ(k, (p - 1).exact_digit_count());
+    size_t estimate = (p - 1).size_in_base(10);
+    EXPECT_TRUE(estimate >= k && estimate <= k + 2);
+  }
+}
+
+TEST(correctness, scientific) {
+  EXPECT_EQ("0e0", big_integer().to_scientific(0));
+  EXPECT_EQ("0.000e0", big_integer().to_scientific(3));
+  EXPECT_EQ("-1.2e1", big_integer(-12).to_scientific(1));
+  EXPECT_EQ("1.2000e1", big_integer(12).to_scientific(4));
+  EXPECT_EQ("1.2e2", big_integer(125).to_scientific(1));
+  EXPECT_EQ("1.4e2", big_integer(135).to_scientific(1));
+  EXPECT_EQ("1.0e3", big_integer(999).to_scientific(1));
+  EXPECT_EQ("", big_integer(123).leading_digits(0));
+  EXPECT_EQ("123", big_integer(-123).leading_digits(5));
+
+  big_integer p = 1;
+  for (int i = 0; i < 3000; ++i) {
+    p *= 7;
+  }
+  std::string decimal = to_string(p);
+  EXPECT_EQ(decimal.substr(0, 40), p.leading_digits(40));
+  std::string scientific = p.to_scientific(19);
+  EXPECT_EQ(decimal.substr(0, 1) + "." + decimal.substr(1, 18), scientific.substr(0, 20));
+  EXPECT_EQ("e" + std::to_string(decimal.size() - 1), scientific.substr(21));
+
+  // Ties and carries far below the leading limbs need the exact fallback.
+  big_integer ten_power = big_integer("1" + std::string(5000, '0'));
+  EXPECT_EQ("2.5e5001", (ten_power * 25).to_scientific(1));
+  EXPECT_EQ("2e5001", (ten_power * 25).to_scientific(0));
+  EXPECT_EQ("4e5001", (ten_power * 35).to_scientific(0));
+  EXPECT_EQ("3e5001", (ten_power * 35 - 1).to_scientific(0));
+  EXPECT_EQ("3e5001", (ten_power * 25 + 1).to_scientific(0));
+  EXPECT_EQ("1.00e5000", (ten_power - 1).to_scientific(2));
+  EXPECT_EQ("999", (ten_power - 1).leading_digits(3));
+  EXPECT_EQ("100", ten_power.leading_digits(3));
+}
+
+TEST(correctness, power_cache) {
+  big_integer p = 1;
+  for (int i = 0; i < 4000; ++i) {
+    p *= 3;
+  }
+  std::string decimal = to_string(p);
+  std::string base7 = to_string(p, 7);
+
+  big_integer::clear_power_cache();
+  big_integer::prewarm_power_cache(100000);
+  big_integer::prewarm_power_cache(1000, 7);
+  EXPECT_EQ(decimal, to_string(p));
+  EXPECT_EQ(base7, to_string(p, 7));
+  big_integer::clear_power_cache();
+  EXPECT_EQ(p, big_integer(decimal));
+  EXPECT_EQ(p, big_integer(base7, 7));
+  EXPECT_THROW(big_integer::prewarm_power_cache(10, 37), std::invalid_argument);
+}
+
+TEST(correctness, ostream_flags) {
+  std::ostringstream out;
+  out << big_integer(-255) << ' ' << std::hex << big_integer(255) << ' ' << std::showbase << std::uppercase
+      << big_integer(255) << ' ' << std::oct << big_integer(8) << ' ' << big_integer(0);
+  EXPECT_EQ("-255 ff 0XFF 010 0", out.str());
+
+  out.str("");
+  out << std::dec << std::showpos << std::setfill('*') << std::setw(6) << big_integer(42) << '|' << std::left
+      << std::setw(6) << big_integer(-42) << '|' << std::internal << std::setw(6) << big_integer(-42) << '|'
+      << big_integer(7);
+  EXPECT_EQ("***+42|-42***|-***42|+7", out.str());
+}
+
+TEST(correctness, istream) {
+  std::istringstream in("  -123456789012345678901234567890 ff 0x1F 017 +5 x");
+  big_integer a, b, c, d, e, f = 7;
+  in >> a >> std::hex >> b >> c;
+  in.unsetf(std::ios_base::basefield);
+  in >> d >> e;
+  EXPECT_TRUE(in);
+  EXPECT_EQ(big_integer("-123456789012345678901234567890"), a);
+  EXPECT_EQ(255, b);
+  EXPECT_EQ(31, c);
+  EXPECT_EQ(15, d);
+  EXPECT_EQ(5, e);
+  in >> f;
+  EXPECT_TRUE(in.fail());
+  EXPECT_EQ(0, f);
+}
+
+TEST(correctness, istream_failure) {
+  // Same value and state as long long: zero when no number can be read, unchanged when the input is empty.
+  for (const char* input : {"x", "-", "+ 1", "0x", "0xg", "", "  "}) {
+    std::istringstream in(input);
+    std::istringstream expected_in(input);
+    big_integer a = 7;
+    long long expected = 7;
+    in >> std::hex >> a;
+    expected_in >> std::hex >> expected;
+    EXPECT_EQ(expected, a) << input;
+    EXPECT_EQ(expected_in.rdstate(), in.rdstate()) << input;
+  }
+}
+
+TEST(correctness, stream_long) {
+  big_integer p = 1;
+  for (int i = 0; i < 30000; ++i) {
+    p *= 10;
+  }
+  std::string digits = "1" + std::string(29999, '0') + "1";
+  std::ostringstream out;
+  out << p + 1 << ' ' << std::hex << (big_integer(1) << 50001);
+  EXPECT_EQ(digits + " 2" + std::string(12500, '0'), out.str());
+
+  std::istringstream in(out.str());
+  big_integer a, b;
+  in >> a >> std::hex >> b;
+  EXPECT_TRUE(in.eof());
+  EXPECT_EQ(p + 1, a);
+  EXPECT_EQ(big_integer(1) << 50001, b);
+}
+
+TEST(correctness, string_conv_bases_long) {
+  big_integer p = 1;
+  for (int i = 0; i < 2000; ++i) {
+    p *= 7;
+  }
+  EXPECT_EQ("1" + std::string(2000, '0'), to_string(p, 7));
+  EXPECT_EQ(std::string(2000, '6'), to_string(p - 1, 7));
+  EXPECT_EQ(p - 1, big_integer(std::string(2000, '6'), 7));
+
+  big_integer q = (big_integer(1) << 4001) - 1;
+  EXPECT_EQ("1" + std::string(1000, 'f'), to_string(q, 16));
+  EXPECT_EQ("3" + std::string(1333, '7'), to_string(q, 8));
+  EXPECT_EQ(std::string(4001, '1'), to_string(q, 2));
+  EXPECT_EQ(q, big_integer("1" + std::string(1000, 'F'), 16));
+  EXPECT_EQ(-q, big_integer("-000" + std::string(4001, '1'), 2));
+}
+
 namespace {
 template <typename T>
 void test_converting_ctor(T value) {